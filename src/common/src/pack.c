@@ -39,7 +39,7 @@ static struct pack_entry* pack_add_entry(struct pack_map *map)
 static struct pack_entry* pack_find_entry(struct pack_map *map, char *name)
 {
   struct pack_entry *e = map->head;
-  while (e != NULL && strcmp(e->name, name) != 0) e = e->next;
+  while (e != NULL && (e->name == NULL || strcmp(e->name, name) != 0)) e = e->next;
   return e;
 }
 
@@ -73,8 +73,10 @@ void pack_map_free(struct pack_map *map)
     free(p->name);
     switch (p->type)
     {
-      case PACK_TYPE_STR: free(p->val.s); break;
-      case PACK_TYPE_MAP: pack_map_free(p->val.m); break;
+      case PACK_TYPE_STR:  free(p->val.s); break;
+      case PACK_TYPE_BUF:  free(p->val.d); break;
+      case PACK_TYPE_LIST: pack_map_free(p->val.m); break;
+      case PACK_TYPE_MAP:  pack_map_free(p->val.m); break;
     }
     free(p);
     p = q;
@@ -99,31 +101,40 @@ char* pack_debug(struct pack_map *map)
   buf[off++] = '[';
 
   struct pack_entry *p = map->head;
-  while (p != NULL && off < max_len)
+  while (p != NULL && off < max_len-1)
   {
     int tlen = 1024;
     char temp[tlen+1];
     int i = 0;
     int k = 0;
+    char *sub;
 
     if (off > 1) i += sprintf(temp, ", ");
-    i += snprintf(&temp[i], (tlen-i), "%s:", p->name);
+    if (p->name != NULL) i += snprintf(&temp[i], (tlen-i), "%s:", p->name);
+    if (i > tlen) i = tlen;
 
     switch (p->type)
     {
       case PACK_TYPE_BOOL: i += snprintf(&temp[i], (tlen-i), "%d",   p->val.b); break;
       case PACK_TYPE_INT:  i += snprintf(&temp[i], (tlen-i), "%lld", p->val.i); break;
       case PACK_TYPE_STR:  i += snprintf(&temp[i], (tlen-i), "%s",   p->val.s); break;
-      case PACK_TYPE_LIST: i += snprintf(&temp[i], (tlen-i), "TODO"); break;
-      case PACK_TYPE_MAP:  i += snprintf(&temp[i], (tlen-i), "%s", pack_debug(p->val.m)); break;
+      case PACK_TYPE_LIST:
+      case PACK_TYPE_MAP:
+        sub = pack_debug(p->val.m);
+        i += snprintf(&temp[i], (tlen-i), "%s", sub);
+        free(sub);
+        break;
       case PACK_TYPE_BUF:
-        for (k=0; k<p->vlen; k++)
+        for (k=0; k<p->vlen && i<tlen-2; k++)
           i += snprintf(&temp[i], (tlen-i), "%02x", p->val.d[k]);
         break;
     }
 
+    // snprintf returns untruncated length; clamp to buffers
+    if (i > tlen) i = tlen;
     temp[i] = '\0';
     off += snprintf(&buf[off], (max_len-off), "%s", temp);
+    if (off > max_len-1) off = max_len-1;
     p = p->next;
   }
 
@@ -193,6 +204,18 @@ uint8_t* pack_get_buf(struct pack_map *map, char *name)
   return e->val.d;
 }
 
+/*
+ * Get length of byte array for given name. If name is not
+ * found, or if type does not match returns 0.
+ */
+uint16_t pack_get_buf_len(struct pack_map *map, char *name)
+{
+  struct pack_entry *e = pack_find_entry(map, name);
+  if (e == NULL) return 0;
+  if (e->type != PACK_TYPE_BUF) return 0;
+  return e->vlen;
+}
+
 /*
  * Get value for given name as pack_map. If name is not
  * found, or if type does not match returns NULL.
@@ -205,6 +228,20 @@ struct pack_map* pack_get_map(struct pack_map *map, char *name)
   return e->val.m;
 }
 
+/*
+ * Get value for given name as a list. List elements are stored
+ * as unnamed entries of a pack_map, and may be iterated using
+ * 'list->head' and 'entry->next'. If name is not found, or if
+ * type does not match returns NULL.
+ */
+struct pack_map* pack_get_list(struct pack_map *map, char *name)
+{
+  struct pack_entry *e = pack_find_entry(map, name);
+  if (e == NULL) return NULL;
+  if (e->type != PACK_TYPE_LIST) return NULL;
+  return e->val.m;
+}
+
 //////////////////////////////////////////////////////////////////////////
 // Setters
 //////////////////////////////////////////////////////////////////////////
@@ -280,30 +317,100 @@ void pack_set_map(struct pack_map *map, char *name, struct pack_map *val)
   e->val.m = val;
 }
 
+/*
+ * Set 'name' to list 'val', where 'val' is a pack_map allocated
+ * with 'pack_map_new' and populated with 'pack_list_add_xxx'.
+ * The list is freed when the parent map is freed.
+ */
+void pack_set_list(struct pack_map *map, char *name, struct pack_map *val)
+{
+  struct pack_entry *e = pack_add_entry(map);
+  e->name  = strdup(name);
+  e->type  = PACK_TYPE_LIST;
+  e->val.m = val;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Lists
+//////////////////////////////////////////////////////////////////////////
+
+/*
+ * Append integer 'val' to given list.
+ */
+void pack_list_add_int(struct pack_map *list, int64_t val)
+{
+  struct pack_entry *e = pack_add_entry(list);
+  e->name  = NULL;
+  e->type  = PACK_TYPE_INT;
+  e->val.i = val;
+}
+
+/*
+ * Append a copy of byte array 'val' to given list.
+ */
+void pack_list_add_buf(struct pack_map *list, uint8_t *val, uint16_t len)
+{
+  struct pack_entry *e = pack_add_entry(list);
+  e->name  = NULL;
+  e->type  = PACK_TYPE_BUF;
+
+  uint8_t *data = (uint8_t *)malloc(len);
+  memcpy(data, val, len);
+  e->val.d = data;
+  e->vlen  = len;
+}
+
+/*
+ * Append pack_map 'val' to given list. The map is freed
+ * when the list is freed.
+ */
+void pack_list_add_map(struct pack_map *list, struct pack_map *val)
+{
+  struct pack_entry *e = pack_add_entry(list);
+  e->name  = NULL;
+  e->type  = PACK_TYPE_MAP;
+  e->val.m = val;
+}
+
 //////////////////////////////////////////////////////////////////////////
 // Encode
 //////////////////////////////////////////////////////////////////////////
 
+static uint16_t pack_entries_enc_size(struct pack_map *map);
+
+/*
+ * Determine number of bytes required to encode the value
+ * of given entry, not including the type code.
+ */
+static uint16_t pack_val_enc_size(struct pack_entry *p)
+{
+  switch (p->type)
+  {
+    case PACK_TYPE_BOOL: return 1;
+    case PACK_TYPE_INT:  return 8;
+    case PACK_TYPE_STR:  return 2 + strlen(p->val.s);
+    case PACK_TYPE_BUF:  return 2 + p->vlen;
+    case PACK_TYPE_LIST: return 2 + pack_entries_enc_size(p->val.m);
+    case PACK_TYPE_MAP:  return 2 + pack_entries_enc_size(p->val.m);
+  }
+  return 0;
+}
+
 /*
- * Determine number of bytes required to encode given map.
- * Does not include 4-byte header (magic + len).
+ * Determine number of bytes required to encode entries of
+ * given map or list. Does not include 4-byte header (magic
+ * + len). List entries have no name and are encoded as
+ * type code + value only.
  */
-static uint16_t pack_map_enc_size(struct pack_map *map)
+static uint16_t pack_entries_enc_size(struct pack_map *map)
 {
   struct pack_entry *p = map->head;
   uint16_t len = 0;
 
   while (p != NULL)
   {
-    len += 1 + strlen(p->name);
-    switch (p->type)
-    {
-      case PACK_TYPE_BOOL: len += 2; break;
-      case PACK_TYPE_INT:  len += 9; break;
-      case PACK_TYPE_STR:  len += 3 + strlen(p->val.s); break;
-      case PACK_TYPE_BUF:  len += 3 + p->vlen; break;
-      case PACK_TYPE_MAP:  len += 3 + pack_map_enc_size(p->val.m); break;
-    }
+    if (p->name != NULL) len += 1 + strlen(p->name);
+    len += 1 + pack_val_enc_size(p);
     p = p->next;
   }
 
@@ -311,44 +418,29 @@ static uint16_t pack_map_enc_size(struct pack_map *map)
 }
 
 /*
- * Encode pack map into byte buffer.  Returns pointer to buffer,
- * or NULL if error occurred.
+ * Encode entries of given map or list into buf starting at
+ * 'off'. Returns the new offset.
  */
-uint8_t* pack_encode(struct pack_map *map)
+static uint16_t pack_encode_entries(struct pack_map *map, uint8_t *buf, uint16_t off)
 {
   struct pack_entry *p = map->head;
-
-  // TODO: use a auto-grow byte buffer to avoid double scan
-  // TODO: check bounds!!!
-  uint16_t len = pack_map_enc_size(map);
-
-  uint8_t *buf = (uint8_t *)malloc(len+4);
-  uint16_t off = 0;
   uint8_t nlen;
   uint16_t i, vlen;
-  uint8_t *sub_buf;
-
-  // magic
-  buf[off++] = 0x70;
-  buf[off++] = 0x6b;
 
-  // length
-  buf[off++] = (len >> 8) & 0xff;
-  buf[off++] = len & 0xff;
-
-  // encode entries
-  p = map->head;
   while (p != NULL)
   {
-    nlen = strlen(p->name);
-    buf[off++] = nlen;
-    for (i=0; i<nlen; i++) buf[off++] = p->name[i];
+    if (p->name != NULL)
+    {
+      nlen = strlen(p->name);
+      buf[off++] = nlen;
+      for (i=0; i<nlen; i++) buf[off++] = p->name[i];
+    }
 
     buf[off++] = p->type;
     switch (p->type)
     {
       case PACK_TYPE_BOOL:
-        buf[off++] = p->val.i & 0xff;
+        buf[off++] = p->val.b ? 1 : 0;
         break;
 
       case PACK_TYPE_INT:
@@ -373,25 +465,47 @@ uint8_t* pack_encode(struct pack_map *map)
         vlen = p->vlen;
         buf[off++] = (vlen >> 8) & 0xff;
         buf[off++] = vlen & 0xff;
-        for (i=0; i<vlen; i++) buf[off++] = p->val.d[i];
+        memcpy(&buf[off], p->val.d, vlen);
+        off += vlen;
         break;
 
+      case PACK_TYPE_LIST:
       case PACK_TYPE_MAP:
-        // TODO: encode directly into auto-grow byte buffer
         vlen = p->val.m->size;
         buf[off++] = (vlen >> 8) & 0xff;
         buf[off++] = vlen & 0xff;
-        sub_buf = pack_encode(p->val.m);
-        vlen = pack_map_enc_size(p->val.m);
-        memcpy(&buf[off], &sub_buf[4], vlen);
-        off += vlen;
-        free(sub_buf);
+        off = pack_encode_entries(p->val.m, buf, off);
         break;
     }
 
     p = p->next;
   }
 
+  return off;
+}
+
+/*
+ * Encode pack map into byte buffer.  Returns pointer to buffer,
+ * or NULL if error occurred.
+ */
+uint8_t* pack_encode(struct pack_map *map)
+{
+  // TODO: check bounds!!!
+  uint16_t len = pack_entries_enc_size(map);
+
+  uint8_t *buf = (uint8_t *)malloc(len+4);
+  uint16_t off = 0;
+
+  // magic
+  buf[off++] = 0x70;
+  buf[off++] = 0x6b;
+
+  // length
+  buf[off++] = (len >> 8) & 0xff;
+  buf[off++] = len & 0xff;
+
+  // encode entries
+  pack_encode_entries(map, buf, off);
   return buf;
 }
 
@@ -399,97 +513,136 @@ uint8_t* pack_encode(struct pack_map *map)
 // Decode
 //////////////////////////////////////////////////////////////////////////
 
+static int pack_decode_entries(uint8_t *buf, uint16_t *off, struct pack_map *map,
+                               uint16_t count, bool named);
+
 /*
- * Decode byte buffer into pack_map instance. Returns pointer
- * new map, or NULL if error occurred.
+ * Decode the next entry from buf at 'off' and append to map.
+ * If 'named' is false, the entry is a list element and has
+ * no name. Returns 0 on success or -1 if an unknown type
+ * was found.
  */
-struct pack_map* pack_decode(uint8_t *buf)
+static int pack_decode_entry(uint8_t *buf, uint16_t *off, struct pack_map *map, bool named)
 {
-  // sanity checks
-  if (buf[0] != 0x70) return NULL;
-  if (buf[1] != 0x6b) return NULL;
-
-  // read length
-  uint16_t len = BYTES_TO_U16(buf[2], buf[3]) + 4;
-  uint16_t off = 4;
-
-  struct pack_map *map = pack_map_new();
-  char *name;
+  char *name = NULL;
   union pack_val val;
   uint8_t nlen, type;
-  uint16_t i, vlen;
+  uint16_t i, vlen = 0;
   char *sval;
   uint8_t *dval;
   uint64_t uval;
 
-  while (off < len)
+  // read name
+  if (named)
   {
-    // read name
-    nlen = buf[off++];
+    nlen = buf[(*off)++];
     name = (char *)malloc(nlen+1);
-    for (i=0; i<nlen; i++) name[i] = buf[off++];
+    for (i=0; i<nlen; i++) name[i] = buf[(*off)++];
     name[nlen] = '\0';
+  }
 
-    // read value
-    type = buf[off++];
-    switch (type)
-    {
-      case PACK_TYPE_BOOL:
-        val.i = buf[off++] == 0 ? 0 : 1;
-        break;
+  // read value
+  type = buf[(*off)++];
+  switch (type)
+  {
+    case PACK_TYPE_BOOL:
+      val.b = buf[(*off)++] == 0 ? 0 : 1;
+      break;
+
+    case PACK_TYPE_INT:
+      uval = ((uint64_t)buf[*off]   << 56) |
+             ((uint64_t)buf[*off+1] << 48) |
+             ((uint64_t)buf[*off+2] << 40) |
+             ((uint64_t)buf[*off+3] << 32) |
+             ((uint64_t)buf[*off+4] << 24) |
+             ((uint64_t)buf[*off+5] << 16) |
+             ((uint64_t)buf[*off+6] << 8)  |
+             ((uint8_t)buf[*off+7]);
+      if (uval <= 0x7fffffffffffffffu) val.i = uval;
+      else val.i = (-1 - (int64_t)(0xffffffffffffffffu - uval));
+      *off += 8;
+      break;
+
+    case PACK_TYPE_STR:
+      vlen = BYTES_TO_U16(buf[*off], buf[*off+1]);
+      *off += 2;
+      sval = (char *)malloc(vlen+1);
+      for (i=0; i<vlen; i++) sval[i] = buf[(*off)++];
+      sval[vlen] = '\0';
+      val.s = sval;
+      break;
+
+    case PACK_TYPE_BUF:
+      vlen = BYTES_TO_U16(buf[*off], buf[*off+1]);
+      *off += 2;
+      dval = (uint8_t *)malloc(vlen);
+      memcpy(dval, &buf[*off], vlen);
+      *off += vlen;
+      val.d = dval;
+      break;
+
+    case PACK_TYPE_LIST:
+    case PACK_TYPE_MAP:
+      vlen = BYTES_TO_U16(buf[*off], buf[*off+1]);
+      *off += 2;
+      val.m = pack_map_new();
+      if (pack_decode_entries(buf, off, val.m, vlen, type == PACK_TYPE_MAP) < 0)
+      {
+        pack_map_free(val.m);
+        free(name);
+        return -1;
+      }
+      break;
 
-      case PACK_TYPE_INT:
-        uval = ((uint64_t)buf[off]   << 56) |
-               ((uint64_t)buf[off+1] << 48) |
-               ((uint64_t)buf[off+2] << 40) |
-               ((uint64_t)buf[off+3] << 32) |
-               ((uint64_t)buf[off+4] << 24) |
-               ((uint64_t)buf[off+5] << 16) |
-               ((uint64_t)buf[off+6] << 8)  |
-               ((uint8_t)buf[off+7]);
-        if (uval <= 0x7fffffffffffffffu) val.i = uval;
-        else val.i = (-1 - (int64_t)(0xffffffffffffffffu - uval));
-        off += 8;
-        break;
+    default:
+      free(name);
+      return -1;
+  }
 
-      case PACK_TYPE_STR:
-        vlen = BYTES_TO_U16(buf[off], buf[off+1]);
-        off += 2;
-        sval = (char *)malloc(vlen+1);
-        for (i=0; i<vlen; i++) sval[i] = buf[off++];
-        sval[vlen] = '\0';
-        val.s = sval;
-        break;
+  // append node to linked list
+  struct pack_entry *e = pack_add_entry(map);
+  e->name = name;
+  e->type = type;
+  e->val  = val;
+  e->vlen = type==PACK_TYPE_BUF ? vlen : 0;
+  return 0;
+}
 
-      case PACK_TYPE_BUF:
-        vlen = BYTES_TO_U16(buf[off], buf[off+1]);
-        off += 2;
-        dval = (uint8_t *)malloc(vlen);
-        for (i=0; i<vlen; i++) dval[i] = buf[off++];
-        val.d = dval;
-        break;
+/*
+ * Decode 'count' entries from buf at 'off' into given map.
+ * Returns 0 on success or -1 if decode failed.
+ */
+static int pack_decode_entries(uint8_t *buf, uint16_t *off, struct pack_map *map,
+                               uint16_t count, bool named)
+{
+  uint16_t i;
+  for (i=0; i<count; i++)
+    if (pack_decode_entry(buf, off, map, named) < 0) return -1;
+  return 0;
+}
 
-      // case PACK_TYPE_LIST:
-      //   vlen = ((buf[off] << 8) & 0xff) | (buf[off+1] & 0xff);
-      //   off += 2;
-      //   break;
+/*
+ * Decode byte buffer into pack_map instance. Returns pointer
+ * new map, or NULL if error occurred.
+ */
+struct pack_map* pack_decode(uint8_t *buf)
+{
+  // sanity checks
+  if (buf[0] != 0x70) return NULL;
+  if (buf[1] != 0x6b) return NULL;
 
-      // case PACK_TYPE_MAP;
-      //   vlen = ((buf[off] << 8) & 0xff) | (buf[off+1] & 0xff);
-      //   off += 2;
-      //   break;
+  // read length
+  uint16_t len = BYTES_TO_U16(buf[2], buf[3]) + 4;
+  uint16_t off = 4;
 
-      default:
-        free(name);
-        continue;
+  struct pack_map *map = pack_map_new();
+  while (off < len)
+  {
+    if (pack_decode_entry(buf, &off, map, true) < 0)
+    {
+      pack_map_free(map);
+      return NULL;
     }
-
-    // append node to linked list
-    struct pack_entry *e = pack_add_entry(map);
-    e->name = name;
-    e->type = type;
-    e->val  = val;
-    e->vlen = type==PACK_TYPE_BUF ? vlen : 0;
   }
 
   return map;
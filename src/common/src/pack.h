@@ -59,13 +59,20 @@ bool pack_get_bool(struct pack_map *map, char *name);
 int64_t pack_get_int(struct pack_map *map, char *name);
 char* pack_get_str(struct pack_map *map, char *name);
 uint8_t* pack_get_buf(struct pack_map *map, char *name);
+uint16_t pack_get_buf_len(struct pack_map *map, char *name);
 struct pack_map* pack_get_map(struct pack_map *map, char *name);
+struct pack_map* pack_get_list(struct pack_map *map, char *name);
 
 void pack_set_bool(struct pack_map *map, char *name, bool val);
 void pack_set_int(struct pack_map *map, char *name, int64_t val);
 void pack_set_str(struct pack_map *map, char *name, char *val);
 void pack_set_buf(struct pack_map *map, char *name, uint8_t *val, uint16_t len);
 void pack_set_map(struct pack_map *map, char *name, struct pack_map *val);
+void pack_set_list(struct pack_map *map, char *name, struct pack_map *val);
+
+void pack_list_add_int(struct pack_map *list, int64_t val);
+void pack_list_add_buf(struct pack_map *list, uint8_t *val, uint16_t len);
+void pack_list_add_map(struct pack_map *list, struct pack_map *val);
 
 uint8_t* pack_encode(struct pack_map *map);
 struct pack_map* pack_decode(uint8_t *buf);
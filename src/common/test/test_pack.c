@@ -146,6 +146,8 @@ void test_bufs_big()
   verify(pack_has(map, "big"));
   verify_int(map->size, 1);
   verify_buf(pack_get_buf(map, "big"), big, 320);
+  verify_int(pack_get_buf_len(map, "big"), 320);
+  verify_int(pack_get_buf_len(map, "foo"), 0);
 
   // test encode/decode
   uint8_t enc_prefix[] = { 0x70, 0x6b, 0x01, 0x47,
@@ -178,7 +180,6 @@ void test_bufs_big()
   pack_map_free(test);
   pack_buf_free(b);
   free(enc);
-  free(buf);
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -213,6 +214,81 @@ void test_maps()
   free(buf);
 }
 
+//////////////////////////////////////////////////////////////////////////
+// test_lists
+//////////////////////////////////////////////////////////////////////////
+
+void test_lists()
+{
+  struct pack_map *map = pack_map_new();
+
+  struct pack_map *list = pack_map_new();
+  pack_list_add_int(list, 7);
+  uint8_t d[] = { 0xab, 0xcd };
+  pack_list_add_buf(list, d, 2);
+  struct pack_map *m = pack_map_new();
+  pack_set_int(m, "x", 1);
+  pack_list_add_map(list, m);
+  pack_set_list(map, "l", list);
+
+  verify_int(map->size, 1);
+  verify(pack_get_list(map, "l") == list);
+  verify(pack_get_map(map, "l") == NULL);
+  verify_int(list->size, 3);
+
+  uint8_t enc[] = { 0x70, 0x6b, 0x00, 0x21,
+                    0x01, 0x6c, 0x60, 0x00, 0x03,
+                    0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07,
+                    0x50, 0x00, 0x02, 0xab, 0xcd,
+                    0x70, 0x00, 0x01,
+                    0x01, 0x78, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01 };
+
+  uint8_t *buf = pack_encode(map);
+  verify_buf(buf, enc, sizeof(enc));
+  free(buf);
+  pack_map_free(map);
+
+  // decode
+  map = pack_decode(enc);
+  verify(map != NULL);
+  list = pack_get_list(map, "l");
+  verify(list != NULL);
+  verify_int(list->size, 3);
+
+  struct pack_entry *e = list->head;
+  verify_int(e->type, PACK_TYPE_INT);
+  verify_int(e->val.i, 7);
+  e = e->next;
+  verify_int(e->type, PACK_TYPE_BUF);
+  verify_int(e->vlen, 2);
+  verify_buf(e->val.d, d, 2);
+  e = e->next;
+  verify_int(e->type, PACK_TYPE_MAP);
+  verify_int(pack_get_int(e->val.m, "x"), 1);
+  verify(e->next == NULL);
+
+  char *s = pack_debug(map);
+  verify_str(s, "[l:[7, abcd, [x:1]]]");
+  free(s);
+
+  // decode fields after nested values
+  uint8_t enc2[] = { 0x70, 0x6b, 0x00, 0x14,
+                     0x01, 0x6d, 0x70, 0x00, 0x01,
+                     0x01, 0x62, 0x10, 0x01,
+                     0x01, 0x69, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05 };
+  struct pack_map *test = pack_decode(enc2);
+  verify(pack_get_bool(pack_get_map(test, "m"), "b"));
+  verify(!pack_has(test, "b"));
+  verify_int(pack_get_int(test, "i"), 5);
+
+  // unknown type fails
+  uint8_t bad[] = { 0x70, 0x6b, 0x00, 0x03, 0x01, 0x62, 0x99 };
+  verify(pack_decode(bad) == NULL);
+
+  pack_map_free(map);
+  pack_map_free(test);
+}
+
 //////////////////////////////////////////////////////////////////////////
 // test_debug
 //////////////////////////////////////////////////////////////////////////
@@ -280,6 +356,7 @@ int main()
   test_bufs_empty();
   test_bufs_big();
   test_maps();
+  test_lists();
   // TODO: test_bool
   // TODO: test_int
   // TODO: test_str
@@ -9,16 +9,18 @@
 // https://github.com/fhunleth/elixir_ale
 */
 
-#include <err.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <poll.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <sys/timerfd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 #include "linux/i2c-dev.h"
 #include "../../common/src/log.h"
@@ -26,9 +28,42 @@
 
 #define I2C_BUFFER_MAX 8192
 
+// Max registers in a single 'read_regs' transaction, where
+// each register uses a write and read msg
+#define I2C_REGS_MAX (I2C_RDRW_IOCTL_MAX_MSGS / 2)
+
+// Max registers sampled by poll mode
+#define I2C_POLL_MAX 64
+
+// Min poll interval in nanoseconds
+#define I2C_POLL_MIN_INTERVAL 1000000
+
+struct i2c_reg
+{
+  uint8_t addr;
+  uint16_t reg;
+  uint8_t reg_size;             // 1 or 2 byte register address
+  uint16_t len;                 // bytes to read
+  uint16_t off;                 // offset into rx block
+};
+
+struct i2c_poll
+{
+  bool active;
+  int tfd;                      // timerfd for poll interval
+  unsigned int n;
+  struct i2c_reg regs[I2C_POLL_MAX];
+  uint8_t last[I2C_BUFFER_MAX]; // last value read for each reg
+  int last_err[I2C_POLL_MAX];   // last errno for each reg or 0
+  bool first;                   // true until first sample is sent
+};
+
 struct i2c_info
 {
   int fd;
+  const char *devpath;
+  char last_err[128];
+  struct i2c_poll poll;
 };
 
 //////////////////////////////////////////////////////////////////////////
@@ -71,16 +106,86 @@ static void send_err(char *msg)
   pack_map_free(res);
 }
 
+/*
+ * Send an error pack response for 'errno' to stdout.
+ */
+static void send_errno(char *prefix)
+{
+  char msg[128];
+  snprintf(msg, sizeof(msg), "%s: %s", prefix, strerror(errno));
+  send_err(msg);
+}
+
 //////////////////////////////////////////////////////////////////////////
 // I2C
 //////////////////////////////////////////////////////////////////////////
 
-static void i2c_init(struct i2c_info *i2c, const char *devpath)
+/*
+ * Open device file. Returns 0 on success, or -1 on failure
+ * with the reason stored in 'i2c->last_err'.
+ */
+static int i2c_open(struct i2c_info *i2c)
+{
+  i2c->fd = open(i2c->devpath, O_RDWR | O_CLOEXEC);
+  if (i2c->fd >= 0) return 0;
+
+  snprintf(i2c->last_err, sizeof(i2c->last_err), "open %s: %s", i2c->devpath, strerror(errno));
+  log_debug("fani2c: %s", i2c->last_err);
+  return -1;
+}
+
+/*
+ * Close and reopen device file after a transient error.
+ * Preserves errno of the original failure if reopen fails.
+ */
+static int i2c_reopen(struct i2c_info *i2c)
+{
+  int e = errno;
+  log_debug("fani2c: reopen %s after error: %s", i2c->devpath, strerror(e));
+  if (i2c->fd >= 0) close(i2c->fd);
+  if (i2c_open(i2c) < 0) { errno = e; return -1; }
+  return 0;
+}
+
+/*
+ * Return true if a failed transaction may be retried on a new
+ * fd. A device can NAK partway through a write, so bus errors
+ * such as a NAK or arbitration loss are only retried when every
+ * msg is a read; writes are only retried if the fd was bad.
+ */
+static bool can_retry(struct i2c_rdwr_ioctl_data *data, int e)
+{
+  if (e == EBADF) return true;
+  if (e != EREMOTEIO && e != EIO && e != ETIMEDOUT && e != EAGAIN) return false;
+
+  unsigned int i;
+  for (i=0; i<data->nmsgs; i++)
+    if (!(data->msgs[i].flags & I2C_M_RD)) return false;
+  return true;
+}
+
+/*
+ * Initialize I2C device. Errors are not fatal and are
+ * reported by the 'status' op.
+ */
+static int i2c_init(struct i2c_info *i2c, const char *devpath)
+{
+  memset(i2c, 0, sizeof(*i2c));
+  i2c->devpath = devpath;
+  i2c->poll.tfd = -1;
+  return i2c_open(i2c);
+}
+
+/*
+ * Perform I2C_RDWR ioctl, retrying once on a fresh fd if a
+ * transient error occurs and the transaction is safe to repeat.
+ * Returns 1 for success, 0 for failure with errno set.
+ */
+static int i2c_rdwr(struct i2c_info *i2c, struct i2c_rdwr_ioctl_data *data)
 {
-  // Fail hard on error. May need to be nicer if this makes the
-  // Fantom side too hard to debug.
-  i2c->fd = open(devpath, O_RDWR);
-  if (i2c->fd < 0) err(EXIT_FAILURE, "open %s", devpath);
+  if (ioctl(i2c->fd, I2C_RDWR, data) >= 0) return 1;
+  if (!can_retry(data, errno) || i2c_reopen(i2c) < 0) return 0;
+  return ioctl(i2c->fd, I2C_RDWR, data) < 0 ? 0 : 1;
 }
 
 /**
@@ -101,7 +206,7 @@ static void i2c_init(struct i2c_info *i2c, const char *devpath)
  *
  * @return  1 for success, 0 for failure
  */
-static int i2c_transfer(const struct i2c_info *i2c,
+static int i2c_transfer(struct i2c_info *i2c,
                         unsigned int addr,
                         const char *to_write, size_t to_write_len,
                         char *to_read, size_t to_read_len)
@@ -126,11 +231,7 @@ static int i2c_transfer(const struct i2c_info *i2c,
 
   data.nmsgs = (to_write_len != 0 && to_read_len != 0) ? 2 : 1;
 
-  int rc = ioctl(i2c->fd, I2C_RDWR, &data);
-  if (rc < 0)
-    return 0;
-  else
-    return 1;
+  return i2c_rdwr(i2c, &data);
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -147,6 +248,8 @@ static void on_status(struct i2c_info *i2c, struct pack_map *req)
   log_debug("fani2c: on_status %s", d);
   free(d);
 
+  // report open failure, retrying in case device appeared
+  if (i2c->fd < 0 && i2c_open(i2c) < 0) { send_err(i2c->last_err); return; }
   send_ok();
 }
 
@@ -165,13 +268,13 @@ static void on_read(struct i2c_info *i2c, struct pack_map *req)
 
   // check inputs
   if (addr > 127) { send_err("invalid 'addr' field"); return; }
-  if (len <= 1 || len > I2C_BUFFER_MAX) { send_err("invalid 'len' field"); return; }
+  if (len < 1 || len > I2C_BUFFER_MAX) { send_err("invalid 'len' field"); return; }
 
   char data[I2C_BUFFER_MAX];
   if (i2c_transfer(i2c, addr, 0, 0, data, len))
     send_ok_data((uint8_t*)data, len);
   else
-    send_err("i2c_read failed");
+    send_errno("i2c_read failed");
 }
 
 /*
@@ -190,13 +293,584 @@ static void on_write(struct i2c_info *i2c, struct pack_map *req)
 
   // check inputs
   if (addr > 127) { send_err("invalid 'addr' field"); return; }
-  if (len <= 1 || len > I2C_BUFFER_MAX) { send_err("invalid 'len' field"); return; }
-  if (data == NULL) { send_err("missing or invalid 'data' field"); return; }
+  if (len < 1 || len > I2C_BUFFER_MAX) { send_err("invalid 'len' field"); return; }
+  if (data == NULL || pack_get_buf_len(req, "data") != len)
+  {
+    send_err("missing or invalid 'data' field");
+    return;
+  }
 
   if (i2c_transfer(i2c, addr, (char *)data, len, 0, 0))
     send_ok();
   else
-    send_err("i2c_write failed");
+    send_errno("i2c_write failed");
+}
+
+/*
+ * Write data then read response in one combined transaction
+ * using a repeated start.
+ */
+static void on_write_read(struct i2c_info *i2c, struct pack_map *req)
+{
+  // debug
+  char *d = pack_debug(req);
+  log_debug("fani2c: on_write_read %s", d);
+  free(d);
+
+  uint8_t addr  = pack_get_int(req, "addr");
+  uint16_t wlen = pack_get_int(req, "wlen");
+  uint8_t *data = pack_get_buf(req, "data");
+  uint16_t len  = pack_get_int(req, "len");
+
+  // check inputs
+  if (addr > 127) { send_err("invalid 'addr' field"); return; }
+  if (wlen < 1 || wlen > I2C_BUFFER_MAX) { send_err("invalid 'wlen' field"); return; }
+  if (data == NULL || pack_get_buf_len(req, "data") != wlen)
+  {
+    send_err("missing or invalid 'data' field");
+    return;
+  }
+  if (len < 1 || len > I2C_BUFFER_MAX) { send_err("invalid 'len' field"); return; }
+
+  char rx[I2C_BUFFER_MAX];
+  if (i2c_transfer(i2c, addr, (char *)data, wlen, rx, len))
+    send_ok_data((uint8_t*)rx, len);
+  else
+    send_errno("i2c_write_read failed");
+}
+
+/*
+ * Perform a list of read and write messages in a single
+ * I2C_RDWR transaction, with a repeated start between each.
+ */
+static void on_transaction(struct i2c_info *i2c, struct pack_map *req)
+{
+  // debug
+  char *d = pack_debug(req);
+  log_debug("fani2c: on_transaction %s", d);
+  free(d);
+
+  struct pack_map *msgs = pack_get_list(req, "msgs");
+
+  // check inputs
+  if (msgs == NULL || msgs->size < 1 || msgs->size > I2C_RDRW_IOCTL_MAX_MSGS)
+  {
+    send_err("missing or invalid 'msgs' field");
+    return;
+  }
+
+  struct pack_entry *e;
+  unsigned int total = 0;
+  for (e = msgs->head; e != NULL; e = e->next)
+  {
+    if (e->type != PACK_TYPE_MAP) { send_err("invalid msg"); return; }
+    struct pack_map *m = e->val.m;
+    int64_t addr = pack_get_int(m, "addr");
+    int64_t len  = pack_get_int(m, "len");
+    if (addr < 0 || addr > 127) { send_err("invalid msg 'addr' field"); return; }
+    if (len < 1 || len > I2C_BUFFER_MAX) { send_err("invalid msg 'len' field"); return; }
+    if (!pack_get_bool(m, "read") &&
+        (pack_get_buf(m, "data") == NULL || pack_get_buf_len(m, "data") != len))
+    {
+      send_err("missing or invalid msg 'data' field");
+      return;
+    }
+    if (pack_get_bool(m, "read")) total += len;
+  }
+  if (total > I2C_BUFFER_MAX) { send_err("total read length too large"); return; }
+
+  // build messages; reads go into a single rx block
+  struct i2c_msg imsgs[I2C_RDRW_IOCTL_MAX_MSGS];
+  uint8_t rx[I2C_BUFFER_MAX];
+  unsigned int i = 0;
+  unsigned int off = 0;
+  for (e = msgs->head; e != NULL; e = e->next, i++)
+  {
+    struct pack_map *m = e->val.m;
+    struct i2c_msg *im = &imsgs[i];
+    im->addr  = pack_get_int(m, "addr");
+    im->len   = pack_get_int(m, "len");
+    im->flags = 0;
+    if (pack_get_bool(m, "nostart"))    im->flags |= I2C_M_NOSTART;
+    if (pack_get_bool(m, "ignore_nak")) im->flags |= I2C_M_IGNORE_NAK;
+    if (pack_get_bool(m, "read"))
+    {
+      im->flags |= I2C_M_RD;
+      im->buf = &rx[off];
+      off += im->len;
+    }
+    else
+    {
+      im->buf = pack_get_buf(m, "data");
+    }
+  }
+
+  struct i2c_rdwr_ioctl_data data;
+  data.msgs  = imsgs;
+  data.nmsgs = msgs->size;
+  if (!i2c_rdwr(i2c, &data))
+  {
+    send_errno("i2c_transaction failed");
+    return;
+  }
+
+  // response contains read data per msg, which is
+  // empty for write msgs
+  struct pack_map *res  = pack_map_new();
+  struct pack_map *list = pack_map_new();
+  for (i=0; i<msgs->size; i++)
+  {
+    if (imsgs[i].flags & I2C_M_RD) pack_list_add_buf(list, imsgs[i].buf, imsgs[i].len);
+    else pack_list_add_buf(list, rx, 0);
+  }
+  pack_set_str(res,  "status", "ok");
+  pack_set_list(res, "rx", list);
+  if (pack_write(stdout, res) < 0) log_debug("fani2c: send_ok failed");
+  pack_map_free(res);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Registers
+//////////////////////////////////////////////////////////////////////////
+
+/*
+ * Encode register address into 'buf' big-endian. Returns
+ * number of bytes written.
+ */
+static int reg_encode(const struct i2c_reg *r, uint8_t *buf)
+{
+  if (r->reg_size == 2)
+  {
+    buf[0] = (r->reg >> 8) & 0xff;
+    buf[1] = r->reg & 0xff;
+    return 2;
+  }
+  buf[0] = r->reg & 0xff;
+  return 1;
+}
+
+/*
+ * Parse register fields from a request map. Returns NULL if
+ * valid or an error message.
+ */
+static char* reg_parse(struct pack_map *m, struct i2c_reg *r)
+{
+  int64_t addr = pack_get_int(m, "addr");
+  int64_t reg  = pack_get_int(m, "reg");
+  int64_t size = pack_has(m, "reg_size") ? pack_get_int(m, "reg_size") : 1;
+  int64_t len  = pack_has(m, "len") ? pack_get_int(m, "len") : 1;
+
+  if (addr < 0 || addr > 127)  return "invalid 'addr' field";
+  if (size != 1 && size != 2)  return "invalid 'reg_size' field";
+  if (reg < 0 || reg > (size == 1 ? 0xff : 0xffff)) return "invalid 'reg' field";
+  if (len < 1 || len > I2C_BUFFER_MAX) return "invalid 'len' field";
+
+  r->addr = addr;
+  r->reg = reg;
+  r->reg_size = size;
+  r->len = len;
+  return NULL;
+}
+
+/*
+ * Parse a list of register maps into 'regs'. Returns NULL
+ * if valid or an error message.
+ */
+static char* regs_parse(struct pack_map *list, struct i2c_reg *regs, unsigned int max)
+{
+  if (list == NULL || list->size < 1 || list->size > max)
+    return "missing or invalid 'regs' field";
+
+  struct pack_entry *e;
+  unsigned int i = 0;
+  unsigned int off = 0;
+  for (e = list->head; e != NULL; e = e->next, i++)
+  {
+    if (e->type != PACK_TYPE_MAP) return "invalid reg";
+    char *msg = reg_parse(e->val.m, &regs[i]);
+    if (msg != NULL) return msg;
+    regs[i].off = off;
+    off += regs[i].len;
+  }
+
+  if (off > I2C_BUFFER_MAX) return "total read length too large";
+  return NULL;
+}
+
+/*
+ * Read a single register.
+ */
+static void on_read_reg(struct i2c_info *i2c, struct pack_map *req)
+{
+  // debug
+  char *d = pack_debug(req);
+  log_debug("fani2c: on_read_reg %s", d);
+  free(d);
+
+  struct i2c_reg r;
+  char *msg = reg_parse(req, &r);
+  if (msg != NULL) { send_err(msg); return; }
+
+  uint8_t wbuf[2];
+  int wlen = reg_encode(&r, wbuf);
+  char rx[I2C_BUFFER_MAX];
+  if (i2c_transfer(i2c, r.addr, (char *)wbuf, wlen, rx, r.len))
+    send_ok_data((uint8_t*)rx, r.len);
+  else
+    send_errno("i2c_read_reg failed");
+}
+
+/*
+ * Write a single register.
+ */
+static void on_write_reg(struct i2c_info *i2c, struct pack_map *req)
+{
+  // debug
+  char *d = pack_debug(req);
+  log_debug("fani2c: on_write_reg %s", d);
+  free(d);
+
+  struct i2c_reg r;
+  char *msg = reg_parse(req, &r);
+  uint8_t *data = pack_get_buf(req, "data");
+  if (msg != NULL) { send_err(msg); return; }
+  if (data == NULL || pack_get_buf_len(req, "data") != r.len || r.len + 2 > I2C_BUFFER_MAX)
+  {
+    send_err("missing or invalid 'data' field");
+    return;
+  }
+
+  // register address and data are sent in one write msg
+  uint8_t wbuf[I2C_BUFFER_MAX];
+  int off = reg_encode(&r, wbuf);
+  memcpy(&wbuf[off], data, r.len);
+  if (i2c_transfer(i2c, r.addr, (char *)wbuf, off + r.len, 0, 0))
+    send_ok();
+  else
+    send_errno("i2c_write_reg failed");
+}
+
+/*
+ * Read a list of registers across one or more devices in a
+ * single I2C_RDWR transaction.
+ */
+static void on_read_regs(struct i2c_info *i2c, struct pack_map *req)
+{
+  // debug
+  char *d = pack_debug(req);
+  log_debug("fani2c: on_read_regs %s", d);
+  free(d);
+
+  struct pack_map *list = pack_get_list(req, "regs");
+  struct i2c_reg regs[I2C_REGS_MAX];
+  char *msg = regs_parse(list, regs, I2C_REGS_MAX);
+  if (msg != NULL) { send_err(msg); return; }
+
+  // each reg is a write of the reg addr followed by a read
+  unsigned int i, n = list->size;
+  struct i2c_msg imsgs[I2C_REGS_MAX * 2];
+  uint8_t wbuf[I2C_REGS_MAX][2];
+  uint8_t rx[I2C_BUFFER_MAX];
+  for (i=0; i<n; i++)
+  {
+    imsgs[i*2].addr  = regs[i].addr;
+    imsgs[i*2].flags = 0;
+    imsgs[i*2].len   = reg_encode(&regs[i], wbuf[i]);
+    imsgs[i*2].buf   = wbuf[i];
+
+    imsgs[i*2+1].addr  = regs[i].addr;
+    imsgs[i*2+1].flags = I2C_M_RD;
+    imsgs[i*2+1].len   = regs[i].len;
+    imsgs[i*2+1].buf   = &rx[regs[i].off];
+  }
+
+  struct i2c_rdwr_ioctl_data data;
+  data.msgs  = imsgs;
+  data.nmsgs = n * 2;
+  if (!i2c_rdwr(i2c, &data))
+  {
+    send_errno("i2c_read_regs failed");
+    return;
+  }
+
+  struct pack_map *res = pack_map_new();
+  struct pack_map *out = pack_map_new();
+  for (i=0; i<n; i++) pack_list_add_buf(out, &rx[regs[i].off], regs[i].len);
+  pack_set_str(res,  "status", "ok");
+  pack_set_list(res, "rx", out);
+  if (pack_write(stdout, res) < 0) log_debug("fani2c: send_ok failed");
+  pack_map_free(res);
+}
+
+/*
+ * SMBus block read, where the device returns the byte count
+ * followed by up to 32 data bytes.
+ */
+static void on_read_block(struct i2c_info *i2c, struct pack_map *req)
+{
+  // debug
+  char *d = pack_debug(req);
+  log_debug("fani2c: on_read_block %s", d);
+  free(d);
+
+  int64_t addr = pack_get_int(req, "addr");
+  int64_t cmd  = pack_get_int(req, "cmd");
+
+  // check inputs
+  if (addr < 0 || addr > 127) { send_err("invalid 'addr' field"); return; }
+  if (cmd < 0 || cmd > 0xff)  { send_err("invalid 'cmd' field"); return; }
+
+  union i2c_smbus_data data;
+  struct i2c_smbus_ioctl_data args;
+  args.read_write = I2C_SMBUS_READ;
+  args.command = cmd;
+  args.size = I2C_SMBUS_BLOCK_DATA;
+  args.data = &data;
+
+  if (ioctl(i2c->fd, I2C_SLAVE, addr) < 0 || ioctl(i2c->fd, I2C_SMBUS, &args) < 0)
+  {
+    send_errno("i2c_read_block failed");
+    return;
+  }
+
+  uint8_t len = data.block[0];
+  if (len > I2C_SMBUS_BLOCK_MAX) len = I2C_SMBUS_BLOCK_MAX;
+  send_ok_data(&data.block[1], len);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Scan
+//////////////////////////////////////////////////////////////////////////
+
+/*
+ * Probe for a device at 'addr' using the same strategy as
+ * i2cdetect: read byte for address ranges commonly used by
+ * EEPROMs and write-only devices, and quick write otherwise.
+ * Returns 1 if a device responded, 0 if not, or -1 if the
+ * address is claimed by a kernel driver.
+ */
+static int i2c_probe(struct i2c_info *i2c, unsigned long funcs, uint8_t addr)
+{
+  if (ioctl(i2c->fd, I2C_SLAVE, addr) < 0)
+    return errno == EBUSY ? -1 : 0;
+
+  union i2c_smbus_data data;
+  struct i2c_smbus_ioctl_data args;
+  bool read_byte = (addr >= 0x30 && addr <= 0x37) || (addr >= 0x50 && addr <= 0x5f);
+  if (!(funcs & I2C_FUNC_SMBUS_QUICK)) read_byte = true;
+
+  if (read_byte)
+  {
+    args.read_write = I2C_SMBUS_READ;
+    args.command = 0;
+    args.size = I2C_SMBUS_BYTE;
+    args.data = &data;
+  }
+  else
+  {
+    args.read_write = I2C_SMBUS_WRITE;
+    args.command = 0;
+    args.size = I2C_SMBUS_QUICK;
+    args.data = NULL;
+  }
+
+  return ioctl(i2c->fd, I2C_SMBUS, &args) < 0 ? 0 : 1;
+}
+
+/*
+ * Probe 7-bit addresses and return presence bitmaps, where bit
+ * 'addr % 8' of byte 'addr / 8' is set if a device responded
+ * ('present') or the address is claimed by a kernel driver
+ * ('busy'). If an 'addrs' list is given only those addresses
+ * are probed, otherwise the full 0x03-0x77 range is scanned.
+ */
+static void on_scan(struct i2c_info *i2c, struct pack_map *req)
+{
+  // debug
+  char *d = pack_debug(req);
+  log_debug("fani2c: on_scan %s", d);
+  free(d);
+
+  unsigned long funcs = 0;
+  if (ioctl(i2c->fd, I2C_FUNCS, &funcs) < 0) { send_errno("i2c_scan failed"); return; }
+  if (!(funcs & (I2C_FUNC_SMBUS_QUICK | I2C_FUNC_SMBUS_READ_BYTE)))
+  {
+    send_err("i2c_scan not supported by adapter");
+    return;
+  }
+
+  uint8_t probe[128];
+  uint8_t present[16];
+  uint8_t busy[16];
+  unsigned int i;
+  memset(probe, 0, sizeof(probe));
+  memset(present, 0, sizeof(present));
+  memset(busy, 0, sizeof(busy));
+
+  struct pack_map *addrs = pack_get_list(req, "addrs");
+  if (addrs != NULL)
+  {
+    struct pack_entry *e;
+    for (e = addrs->head; e != NULL; e = e->next)
+    {
+      if (e->type != PACK_TYPE_INT || e->val.i < 0 || e->val.i > 127)
+      {
+        send_err("invalid 'addrs' field");
+        return;
+      }
+      probe[e->val.i] = 1;
+    }
+  }
+  else
+  {
+    for (i=0x03; i<=0x77; i++) probe[i] = 1;
+  }
+
+  for (i=0; i<128; i++)
+  {
+    if (!probe[i]) continue;
+    int r = i2c_probe(i2c, funcs, i);
+    if (r > 0) present[i / 8] |= 1 << (i % 8);
+    if (r < 0) busy[i / 8] |= 1 << (i % 8);
+  }
+
+  struct pack_map *res = pack_map_new();
+  pack_set_str(res, "status",  "ok");
+  pack_set_buf(res, "present", present, sizeof(present));
+  pack_set_buf(res, "busy",    busy,    sizeof(busy));
+  if (pack_write(stdout, res) < 0) log_debug("fani2c: send_ok failed");
+  pack_map_free(res);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Poll
+//////////////////////////////////////////////////////////////////////////
+
+/*
+ * Timer callback to read all poll registers and push any
+ * values or errors that changed since the last sample.
+ */
+static void poll_sample(struct i2c_info *i2c)
+{
+  struct i2c_poll *p = &i2c->poll;
+
+  uint64_t exp;
+  if (read(p->tfd, &exp, sizeof(exp)) != sizeof(exp)) return;
+
+  struct pack_map *changes = pack_map_new();
+  uint8_t rx[I2C_BUFFER_MAX];
+  unsigned int i;
+
+  // read each reg separately so one missing device does
+  // not fail the whole sample
+  for (i=0; i<p->n; i++)
+  {
+    struct i2c_reg *r = &p->regs[i];
+    uint8_t wbuf[2];
+    int wlen = reg_encode(r, wbuf);
+    uint8_t *cur = &rx[r->off];
+    uint8_t *last = &p->last[r->off];
+
+    if (i2c_transfer(i2c, r->addr, (char *)wbuf, wlen, (char *)cur, r->len))
+    {
+      if (!p->first && p->last_err[i] == 0 && memcmp(cur, last, r->len) == 0) continue;
+      memcpy(last, cur, r->len);
+      p->last_err[i] = 0;
+
+      struct pack_map *c = pack_map_new();
+      pack_set_int(c, "index", i);
+      pack_set_buf(c, "data", cur, r->len);
+      pack_list_add_map(changes, c);
+    }
+    else
+    {
+      int e = errno;
+      if (!p->first && p->last_err[i] == e) continue;
+      p->last_err[i] = e;
+
+      struct pack_map *c = pack_map_new();
+      pack_set_int(c, "index", i);
+      pack_set_str(c, "err", strerror(e));
+      pack_list_add_map(changes, c);
+    }
+  }
+
+  p->first = false;
+  if (changes->size == 0) { pack_map_free(changes); return; }
+
+  struct pack_map *res = pack_map_new();
+  pack_set_str(res,  "event",   "poll");
+  pack_set_list(res, "changes", changes);
+  if (pack_write(stdout, res) < 0) log_debug("fani2c: poll_sample failed");
+  pack_map_free(res);
+}
+
+/*
+ * Stop poll and close timer.
+ */
+static void poll_free(struct i2c_poll *p)
+{
+  if (p->tfd >= 0) close(p->tfd);
+  p->tfd = -1;
+  p->active = false;
+  p->n = 0;
+}
+
+/*
+ * Start polling a list of registers at a fixed interval.
+ */
+static void on_poll_start(struct i2c_info *i2c, struct pack_map *req)
+{
+  // debug
+  char *d = pack_debug(req);
+  log_debug("fani2c: on_poll_start %s", d);
+  free(d);
+
+  struct i2c_poll *p = &i2c->poll;
+  if (p->active) { send_err("poll already started"); return; }
+
+  struct pack_map *list = pack_get_list(req, "regs");
+  char *msg = regs_parse(list, p->regs, I2C_POLL_MAX);
+  if (msg != NULL) { send_err(msg); return; }
+
+  int64_t interval = pack_get_int(req, "interval");
+  if (interval < I2C_POLL_MIN_INTERVAL) { send_err("missing or invalid 'interval' field"); return; }
+
+  p->n = list->size;
+  p->first = true;
+  memset(p->last_err, 0, sizeof(p->last_err));
+
+  // first sample fires immediately
+  p->tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  struct itimerspec its;
+  its.it_interval.tv_sec  = interval / 1000000000;
+  its.it_interval.tv_nsec = interval % 1000000000;
+  its.it_value.tv_sec  = 0;
+  its.it_value.tv_nsec = 1;
+  if (p->tfd < 0 || timerfd_settime(p->tfd, 0, &its, NULL) < 0)
+  {
+    log_debug("fani2c: timerfd failed: %s", strerror(errno));
+    poll_free(p);
+    send_err("failed to start timer");
+    return;
+  }
+
+  p->active = true;
+  send_ok();
+}
+
+/*
+ * Stop polling and ack.
+ */
+static void on_poll_stop(struct i2c_info *i2c, struct pack_map *req)
+{
+  // debug
+  char *d = pack_debug(req);
+  log_debug("fani2c: on_poll_stop %s", d);
+  free(d);
+
+  if (i2c->poll.active) poll_free(&i2c->poll);
+  send_ok();
 }
 
 /*
@@ -207,8 +881,30 @@ static int on_proc_req(struct i2c_info *i2c, struct pack_map *req)
 {
   char *op = pack_get_str(req, "op");
 
+  // device must be open for all other ops
+  if (i2c->fd < 0 && strcmp(op, "status") != 0 && strcmp(op, "exit") != 0)
+  {
+    if (i2c_open(i2c) < 0) { send_err(i2c->last_err); return 0; }
+  }
+
+  // only poll ops are allowed while polling
+  if (i2c->poll.active && strcmp(op, "poll_stop") != 0 && strcmp(op, "exit") != 0)
+  {
+    send_err("poll active");
+    return 0;
+  }
+
   if (strcmp(op, "read")   == 0) { on_read(i2c, req);   return 0; }
   if (strcmp(op, "write")  == 0) { on_write(i2c, req);  return 0; }
+  if (strcmp(op, "write_read")  == 0) { on_write_read(i2c, req);  return 0; }
+  if (strcmp(op, "transaction") == 0) { on_transaction(i2c, req); return 0; }
+  if (strcmp(op, "read_reg")    == 0) { on_read_reg(i2c, req);    return 0; }
+  if (strcmp(op, "write_reg")   == 0) { on_write_reg(i2c, req);   return 0; }
+  if (strcmp(op, "read_regs")   == 0) { on_read_regs(i2c, req);   return 0; }
+  if (strcmp(op, "read_block")  == 0) { on_read_block(i2c, req);  return 0; }
+  if (strcmp(op, "scan")        == 0) { on_scan(i2c, req);        return 0; }
+  if (strcmp(op, "poll_start")  == 0) { on_poll_start(i2c, req);  return 0; }
+  if (strcmp(op, "poll_stop")   == 0) { on_poll_stop(i2c, req);   return 0; }
   if (strcmp(op, "status") == 0) { on_status(i2c, req); return 0; }
   if (strcmp(op, "exit")   == 0) { return -1; }
 
@@ -224,6 +920,7 @@ int main(int argc, char *argv[])
 {
   if (argc != 2) log_fatal("Must pass device path");
 
+  // open failures are reported on first request
   struct i2c_info i2c;
   i2c_init(&i2c, argv[1]);
 
@@ -232,13 +929,18 @@ int main(int argc, char *argv[])
 
   for (;;)
   {
-    struct pollfd fdset[1];
+    struct pollfd fdset[2];
     fdset[0].fd = STDIN_FILENO;
     fdset[0].events = POLLIN;
     fdset[0].revents = 0;
 
-    // wait for stdin message
-    int rc = poll(fdset, 1, -1);
+    // poll timer; ignored by poll if not polling
+    fdset[1].fd = i2c.poll.active ? i2c.poll.tfd : -1;
+    fdset[1].events = POLLIN;
+    fdset[1].revents = 0;
+
+    // wait for stdin message or poll timer
+    int rc = poll(fdset, 2, -1);
     if (rc < 0)
     {
       // Retry if EINTR
@@ -246,6 +948,9 @@ int main(int argc, char *argv[])
       log_fatal("poll");
     }
 
+    if (fdset[1].revents & POLLIN) poll_sample(&i2c);
+    if (!(fdset[0].revents & (POLLIN | POLLHUP))) continue;
+
     // read message
     if (pack_read(stdin, buf) < 0)
     {
@@ -263,6 +968,7 @@ int main(int argc, char *argv[])
   }
 
   // graceful exit
+  if (i2c.poll.active) poll_free(&i2c.poll);
   log_debug("fani2c: bye-bye");
   return 0;
 }
\ No newline at end of file
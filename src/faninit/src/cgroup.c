@@ -0,0 +1,143 @@
+/*
+// Copyright (c) 2026, Andy Frank
+// Licensed under the Apache License version 2.0
+//
+// History:
+//   19 Oct 2026  Andy Frank  Creation
+*/
+
+#include "faninit.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mount.h>
+#include <sys/stat.h>
+
+// Child cgroups created under CGROUP_ROOT
+static const char *cgroup_names[] = {
+  "jvm",
+  "helpers",
+  NULL
+};
+
+// Interface files that may be set with cgroup.<name>.<file>
+static const char *cgroup_files[] = {
+  "memory.max",
+  "memory.high",
+  "memory.low",
+  "memory.min",
+  "memory.swap.max",
+  "cpu.max",
+  "cpu.weight",
+  "pids.max",
+  NULL
+};
+
+/*
+ * Write 'val' to cgroup interface file at 'path'.
+ */
+static int cgroup_write(const char *path, const char *val)
+{
+  int fd = open(path, O_WRONLY | O_CLOEXEC);
+  if (fd < 0) return -1;
+  ssize_t n = write(fd, val, strlen(val));
+  close(fd);
+  return n < 0 ? -1 : 0;
+}
+
+static int is_cgroup_name(const char *name, size_t len)
+{
+  const char **n;
+  for (n = cgroup_names; *n != NULL; n++)
+    if (strlen(*n) == len && strncmp(*n, name, len) == 0) return 1;
+  return 0;
+}
+
+static int is_cgroup_file(const char *file)
+{
+  const char **f;
+  for (f = cgroup_files; *f != NULL; f++)
+    if (strcmp(*f, file) == 0) return 1;
+  return 0;
+}
+
+void setup_cgroups()
+{
+  debug("setup_cgroups");
+
+#ifndef UNITTEST
+  if (mount("cgroup2", CGROUP_ROOT, "cgroup2", MS_NOSUID | MS_NODEV | MS_NOEXEC, NULL) < 0)
+  {
+    warn("Cannot mount cgroup2 at %s: %s", CGROUP_ROOT, strerror(errno));
+    return;
+  }
+#endif
+
+  // enable controllers for child groups; each is optional in
+  // the kernel config so enable one at a time
+  char path[FANINIT_PATH_MAX];
+  snprintf(path, sizeof(path), "%s/cgroup.subtree_control", CGROUP_ROOT);
+  if (cgroup_write(path, "+memory") < 0) warn("Cannot enable memory cgroup controller");
+  if (cgroup_write(path, "+cpu") < 0)    warn("Cannot enable cpu cgroup controller");
+  if (cgroup_write(path, "+pids") < 0)   debug("Cannot enable pids cgroup controller");
+
+  const char **n;
+  for (n = cgroup_names; *n != NULL; n++)
+  {
+    snprintf(path, sizeof(path), "%s/%s", CGROUP_ROOT, *n);
+    if (mkdir(path, 0755) < 0 && errno != EEXIST)
+      warn("Cannot create cgroup %s: %s", path, strerror(errno));
+  }
+
+  // apply limits from cgroup.<name>.<file> props
+  struct prop *p;
+  for (p = props ? props->head : NULL; p != NULL; p = p->next)
+  {
+    if (strncmp(p->name, "cgroup.", 7) != 0) continue;
+    const char *name = p->name + 7;
+    const char *file = strchr(name, '.');
+    if (file == NULL || !is_cgroup_name(name, file - name) || !is_cgroup_file(file + 1))
+    {
+      warn("Unknown cgroup option '%s'", p->name);
+      continue;
+    }
+
+    snprintf(path, sizeof(path), "%s/%.*s/%s", CGROUP_ROOT, (int)(file - name), name, file + 1);
+    debug("cgroup %s=%s", path, p->val);
+    if (cgroup_write(path, p->val) < 0)
+      warn("Cannot set %s to '%s': %s", p->name, p->val, strerror(errno));
+  }
+}
+
+void cgroup_enter(const char *name)
+{
+  char path[FANINIT_PATH_MAX];
+  snprintf(path, sizeof(path), "%s/%s/cgroup.procs", CGROUP_ROOT, name);
+  if (access(path, W_OK) < 0) return;
+
+  // writing 0 moves the calling process
+  if (cgroup_write(path, "0") < 0)
+    warn("Cannot move to cgroup %s: %s", name, strerror(errno));
+}
+
+int cgroup_signal(const char *name, int sig)
+{
+  char path[FANINIT_PATH_MAX];
+  snprintf(path, sizeof(path), "%s/%s/cgroup.procs", CGROUP_ROOT, name);
+  FILE *fp = fopen(path, "r");
+  if (fp == NULL) return -1;
+
+  int n = 0;
+  int pid;
+  while (fscanf(fp, "%d", &pid) == 1)
+  {
+    if (kill(pid, sig) == 0) n++;
+  }
+  fclose(fp);
+  return n;
+}
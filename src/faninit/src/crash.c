@@ -0,0 +1,240 @@
+/*
+// Copyright (c) 2026, Andy Frank
+// Licensed under the Apache License version 2.0
+//
+// History:
+//   19 Oct 2026  Andy Frank  Creation
+*/
+
+#include "faninit.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/klog.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+
+// Ring file layout; all integers are little endian
+//
+//   header:  "FCRH" u16:version u16:slots u32:next u32:count pad to 32
+//   record:  "FCR1" u32:seq s64:time u64:uptime_ms u64:runtime_ms
+//            u8:reason u8:code u16:restarts u32:mem_total_kb
+//            u32:mem_avail_kb u16:kmsg_len kmsg pad to CRASH_RECORD_SIZE
+//
+#define CRASH_VERSION     1
+#define CRASH_HEADER_SIZE 32
+#define CRASH_KMSG_OFF    46
+
+// Wall clock times before 2020-01-01 mean the clock was never set
+#define CRASH_MIN_TIME 1577836800
+
+#define PSTORE_ROOT "/sys/fs/pstore"
+#define PMSG_DEVICE "/dev/pmsg0"
+
+static const char *crash_file = NULL;   // ring file or NULL if disabled
+static int use_pstore = 0;
+static int slots = 16;
+static int kmsg_lines = 8;
+static uint64_t launched_ms = 0;
+
+void crash_init()
+{
+  crash_file = get_prop(props, "crash.file", NULL);
+  if (crash_file == NULL) return;
+
+  slots = get_prop_int(props, "crash.slots", slots, 1, 1024);
+  kmsg_lines = get_prop_int(props, "crash.kmsg", kmsg_lines, 0, 1024);
+
+  // records written to pmsg show up under pstore after reboot
+  if (strcmp(crash_file, "pstore") == 0)
+  {
+    use_pstore = 1;
+    if (mount("pstore", PSTORE_ROOT, "pstore", 0, NULL) < 0 && errno != EBUSY)
+      warn("Cannot mount %s: %s", PSTORE_ROOT, strerror(errno));
+  }
+}
+
+static void put_u16(uint8_t *p, uint16_t v)
+{
+  p[0] = v; p[1] = v >> 8;
+}
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+  int i;
+  for (i=0; i<4; i++) p[i] = v >> (i * 8);
+}
+
+static void put_u64(uint8_t *p, uint64_t v)
+{
+  int i;
+  for (i=0; i<8; i++) p[i] = v >> (i * 8);
+}
+
+static uint16_t get_u16(const uint8_t *p)
+{
+  return p[0] | (p[1] << 8);
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/*
+ * Read a 'kB' value from /proc/meminfo or 0 if not found.
+ */
+static uint32_t meminfo_kb(const char *name)
+{
+  FILE *fp = fopen("/proc/meminfo", "r");
+  if (fp == NULL) return 0;
+
+  char line[128];
+  uint32_t kb = 0;
+  size_t len = strlen(name);
+  while (fgets(line, sizeof(line), fp) != NULL)
+  {
+    if (strncmp(line, name, len) == 0 && line[len] == ':')
+    {
+      kb = strtoul(line + len + 1, NULL, 10);
+      break;
+    }
+  }
+  fclose(fp);
+  return kb;
+}
+
+/*
+ * Copy up to the last 'kmsg_lines' kernel log lines that fit in
+ * 'max' bytes into 'out'. Returns number of bytes copied.
+ */
+static int kmsg_tail(char *out, int max)
+{
+  if (kmsg_lines == 0) return 0;
+
+  int size = klogctl(10, NULL, 0);   // SYSLOG_ACTION_SIZE_BUFFER
+  if (size <= 0) return 0;
+
+  char *buf = malloc(size);
+  if (buf == NULL) return 0;
+  int n = klogctl(3, buf, size);     // SYSLOG_ACTION_READ_ALL
+  if (n <= 0) { free(buf); return 0; }
+
+  // walk back from the end to the start of the Nth last line,
+  // stopping early if the next line would not fit
+  int start = n;
+  int lines = 0;
+  while (start > 0 && lines < kmsg_lines)
+  {
+    int s = start - 1;
+    if (s > 0 && buf[s] == '\n') s--;
+    while (s > 0 && buf[s-1] != '\n') s--;
+    if (n - s > max) break;
+    start = s;
+    lines++;
+  }
+
+  int len = n - start;
+  memcpy(out, buf + start, len);
+  free(buf);
+  return len;
+}
+
+/*
+ * Append record to pstore pmsg.
+ */
+static void write_pmsg(const uint8_t *rec)
+{
+  int fd = open(PMSG_DEVICE, O_WRONLY | O_CLOEXEC);
+  if (fd < 0)
+  {
+    warn("Cannot open %s: %s", PMSG_DEVICE, strerror(errno));
+    return;
+  }
+  OK_OR_WARN(write(fd, rec, CRASH_RECORD_SIZE), "Cannot write %s", PMSG_DEVICE);
+  close(fd);
+}
+
+/*
+ * Write record to next slot of ring file.
+ */
+static void write_ring(uint8_t *rec)
+{
+  int fd = open(crash_file, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0)
+  {
+    warn("Cannot open %s: %s", crash_file, strerror(errno));
+    return;
+  }
+
+  // start a new ring if missing, corrupt, or resized
+  uint8_t hdr[CRASH_HEADER_SIZE];
+  if (pread(fd, hdr, sizeof(hdr), 0) != sizeof(hdr) ||
+      memcmp(hdr, "FCRH", 4) != 0 ||
+      get_u16(hdr + 4) != CRASH_VERSION ||
+      get_u16(hdr + 6) != slots)
+  {
+    memset(hdr, 0, sizeof(hdr));
+    memcpy(hdr, "FCRH", 4);
+    put_u16(hdr + 4, CRASH_VERSION);
+    put_u16(hdr + 6, slots);
+    OK_OR_WARN(ftruncate(fd, CRASH_HEADER_SIZE + (off_t)slots * CRASH_RECORD_SIZE),
+               "Cannot size %s", crash_file);
+  }
+
+  uint32_t next  = get_u32(hdr + 8) % slots;
+  uint32_t count = get_u32(hdr + 12);
+  put_u32(rec + 4, count);
+
+  off_t off = CRASH_HEADER_SIZE + (off_t)next * CRASH_RECORD_SIZE;
+  if (pwrite(fd, rec, CRASH_RECORD_SIZE, off) != CRASH_RECORD_SIZE)
+    warn("Cannot write %s: %s", crash_file, strerror(errno));
+
+  put_u32(hdr + 8, (next + 1) % slots);
+  put_u32(hdr + 12, count + 1);
+  if (pwrite(fd, hdr, sizeof(hdr), 0) != sizeof(hdr))
+    warn("Cannot write %s: %s", crash_file, strerror(errno));
+
+  fsync(fd);
+  close(fd);
+}
+
+void crash_launched()
+{
+  launched_ms = now_ms();
+}
+
+void crash_record(int reason, int code)
+{
+  if (crash_file == NULL) return;
+
+  uint8_t rec[CRASH_RECORD_SIZE];
+  memset(rec, 0, sizeof(rec));
+  uint64_t uptime_ms = now_ms();
+
+  memcpy(rec, "FCR1", 4);
+  put_u32(rec + 4, restart_total());
+  time_t now = time(NULL);
+  put_u64(rec + 8, now < CRASH_MIN_TIME ? 0 : (uint64_t)now);
+  put_u64(rec + 16, uptime_ms);
+  put_u64(rec + 24, uptime_ms - launched_ms);
+  rec[32] = reason;
+  rec[33] = code;
+  put_u16(rec + 34, restart_total());
+  put_u32(rec + 36, meminfo_kb("MemTotal"));
+  put_u32(rec + 40, meminfo_kb("MemAvailable"));
+
+  int len = kmsg_tail((char *)rec + CRASH_KMSG_OFF, CRASH_RECORD_SIZE - CRASH_KMSG_OFF);
+  put_u16(rec + 44, len);
+
+  debug("crash record reason=%d code=%d", reason, code);
+  if (use_pstore) write_pmsg(rec);
+  else write_ring(rec);
+}
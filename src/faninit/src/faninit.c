@@ -32,55 +32,44 @@ static void read_sys_props()
   sys_props = read_props(SYS_PROPS);
 }
 
+/*
+ * Map an exit.action or fatal.action value to the reboot
+ * command, or return 'def' if not set or unknown.
+ */
+static int reboot_cmd_prop(const char *name, int def)
+{
+  const char *val = get_prop(props, name, NULL);
+  if (val == NULL) return def;
+  if (strcmp(val, "hang") == 0)     return LINUX_REBOOT_CMD_HALT;
+  if (strcmp(val, "reboot") == 0)   return LINUX_REBOOT_CMD_RESTART;
+  if (strcmp(val, "poweroff") == 0) return LINUX_REBOOT_CMD_POWER_OFF;
+  warn("Invalid value for %s: '%s'", name, val);
+  return def;
+}
+
 static void read_faninit_props()
 {
   debug("read_faninit_props");
   props = read_props(FANINIT_PROPS);
 
-  struct prop *p = props;
-  for (; p != NULL; p = p->next)
-  {
-    if (strcmp(p->name, "debug") == 0)
-    {
-      // enable debugging
-      if (strcmp(p->val, "true") == 0) options.verbose = 1;
-    }
-    else if (strcmp(p->name, "tty.console") == 0)
-    {
-      // set terminal
-      options.controlling_terminal = strdup(p->val);
-    }
-    else if (strcmp(p->name, "exit.action") == 0)
-    {
-      // set exit.action
-      if (strcmp(p->val, "hang") == 0)
-        options.unintentional_exit_cmd = LINUX_REBOOT_CMD_HALT;
-      else if (strcmp(p->val, "reboot") == 0)
-        options.unintentional_exit_cmd = LINUX_REBOOT_CMD_RESTART;
-      else if (strcmp(p->val, "poweroff") == 0)
-        options.unintentional_exit_cmd = LINUX_REBOOT_CMD_POWER_OFF;
-    }
-    else if (strcmp(p->name, "fatal.action") == 0)
-    {
-      // set exit.action
-      if (strcmp(p->val, "hang") == 0)
-        options.fatal_reboot_cmd = LINUX_REBOOT_CMD_HALT;
-      else if (strcmp(p->val, "reboot") == 0)
-        options.fatal_reboot_cmd = LINUX_REBOOT_CMD_RESTART;
-      else if (strcmp(p->val, "poweroff") == 0)
-        options.fatal_reboot_cmd = LINUX_REBOOT_CMD_POWER_OFF;
-    }
-    else if (strcmp(p->name, "exit.run") == 0)
-    {
-      // set exit.run
-      options.run_on_exit = strdup(p->val);
-    }
-    else if (strcmp(p->name, "fs.mount") == 0)
-    {
-      // add filesystem mounts
-      options.extra_mounts = strdup(p->val);
-    }
-  }
+  // enable debugging
+  if (strcmp(get_prop(props, "debug", "false"), "true") == 0) options.verbose = 1;
+
+  // set terminal
+  const char *val = get_prop(props, "tty.console", NULL);
+  if (val != NULL) options.controlling_terminal = strdup(val);
+
+  // set exit.action and fatal.action
+  options.unintentional_exit_cmd = reboot_cmd_prop("exit.action", options.unintentional_exit_cmd);
+  options.fatal_reboot_cmd = reboot_cmd_prop("fatal.action", options.fatal_reboot_cmd);
+
+  // set exit.run
+  val = get_prop(props, "exit.run", NULL);
+  if (val != NULL) options.run_on_exit = strdup(val);
+
+  // add filesystem mounts
+  val = get_prop(props, "fs.mount", NULL);
+  if (val != NULL) options.extra_mounts = strdup(val);
 }
 
 static void setup_environment()
@@ -104,6 +93,11 @@ static void setup_environment()
   OK_OR_FATAL(asprintf(&envvar, "JAVA_HOME=%s", JAVA_HOME), "asprintf failed");
   putenv(envvar);
 
+  // Export sys.props and faninit.props so Fantom does not
+  // need to parse them again on startup
+  export_props(sys_props, "studs.sys.");
+  export_props(props, "studs.faninit.");
+
   // Set any additional environment variables from the user
   if (options.additional_env)
   {
@@ -116,27 +110,16 @@ static void setup_environment()
   }
 }
 
-static int run_cmd(const char *cmd)
+static int run_argv(char *const argv[])
 {
-  debug("run_cmd '%s'", cmd);
-
   pid_t pid = fork();
   if (pid == 0)
   {
     // child
-    char *cmd_copy = strdup(cmd);
-    char *exec_path = strtok(cmd_copy, " ");
-    char *exec_argv[16];
-    int arg = 0;
-
-    exec_argv[arg++] = exec_path;
-    while ((exec_argv[arg] = strtok(NULL, " ")) != NULL) arg++;
-
-    exec_argv[arg] = 0;
-    if (exec_path) execvp(exec_path, exec_argv);
+    execvp(argv[0], argv);
 
     // Not supposed to reach here.
-    warn("execvp '%s' failed", cmd);
+    warn("execvp '%s' failed", argv[0]);
     exit(EXIT_FAILURE);
   }
   else
@@ -152,6 +135,87 @@ static int run_cmd(const char *cmd)
   }
 }
 
+static int run_cmd(const char *cmd)
+{
+  debug("run_cmd '%s'", cmd);
+
+  struct arglist args = {0};
+  char *cmd_copy = strdup(cmd);
+  char *tok = strtok(cmd_copy, " ");
+  for (; tok != NULL; tok = strtok(NULL, " ")) arglist_add(&args, tok);
+  free(cmd_copy);
+  if (args.argc == 0) return -1;
+
+  int status = run_argv(args.argv);
+
+  int i;
+  for (i=0; i<args.argc; i++) free(args.argv[i]);
+  free(args.argv);
+  return status;
+}
+
+static void run_pre_exec(const void *arg)
+{
+  run_cmd(arg);
+}
+
+/*
+ * Return true if the class data sharing archive at 'archive' can be
+ * used to launch the JVM.  If the archive does not exist and
+ * 'jvm.cds.dump=true', first generate it from the class list staged
+ * by 'fan studs asm'.  The archive is tied to the exact JVM binary
+ * so it is always dumped on the target itself.
+ */
+static int setup_cds(const char *archive, const char *sys_jar_path, const struct arglist *jvm_args)
+{
+  if (access(archive, R_OK) == 0) return 1;
+
+  const char *dump = get_prop(props, "jvm.cds.dump", "false");
+  if (strcmp(dump, "true") != 0)
+  {
+    debug("CDS archive %s not found", archive);
+    return 0;
+  }
+
+  if (access(CDS_CLASSLIST, R_OK) < 0)
+  {
+    warn("CDS class list %s not found", CDS_CLASSLIST);
+    return 0;
+  }
+
+  // dump with the same options the JVM will run with, since
+  // archive use is checked against heap and GC settings
+  struct arglist dump_args = {0};
+  arglist_addf(&dump_args, "%s/bin/java", JAVA_HOME);
+  int i;
+  for (i=1; i<jvm_args->argc; i++) arglist_add(&dump_args, jvm_args->argv[i]);
+  arglist_add(&dump_args, "-Xshare:dump");
+  arglist_addf(&dump_args, "-XX:SharedClassListFile=%s", CDS_CLASSLIST);
+  arglist_addf(&dump_args, "-XX:SharedArchiveFile=%s", archive);
+  arglist_add(&dump_args, "-cp");
+  arglist_add(&dump_args, sys_jar_path);
+
+  timeline_begin("cds_dump");
+  int status = run_argv(dump_args.argv);
+  timeline_end();
+
+  if (status != 0)
+  {
+    // do not leave a partial archive behind
+    warn("CDS archive dump failed for %s", archive);
+    unlink(archive);
+    return 0;
+  }
+
+  return access(archive, R_OK) == 0;
+}
+
+static void run_setup_cgroups(const void *arg)
+{
+  (void) arg;
+  setup_cgroups();
+}
+
 static void drop_privileges()
 {
   if (options.gid > 0)
@@ -167,29 +231,61 @@ static void drop_privileges()
   }
 }
 
-static void child()
+/*
+ * One-time system setup run before the first JVM launch.
+ */
+static void setup_system()
 {
-  // setup system
-  setup_filesystems();
-  setup_environment();
-  setup_networking();
+  // Mounts, loopback, hostname and cgroups are independent of each other and
+  // run concurrently; the pre-run program waits on all of them. The
+  // JVM is launched once every setup task is complete.
+  add_filesystem_tasks();
+  add_networking_tasks();
+  task_add("cgroups", run_setup_cgroups, NULL);
+  if (options.pre_run_exec)
+  {
+    int t = task_add("pre_run_exec", run_pre_exec, options.pre_run_exec);
+    int i;
+    for (i=0; i<t; i++) task_dep(t, i);
+  }
+  task_run_all();
+
+  // Heartbeat fifo for the watchdog now that /run is mounted
+  watchdog_setup_fifo();
 
   // Warn the user if they're on an inactive TTY
   if (options.warn_unused_tty) warn_unused_tty();
+}
+
+static void child(int restart)
+{
+  // fork phase was started in parent
+  timeline_end();
 
-  // Optionally run a "pre-run" program
-  if (options.pre_run_exec) run_cmd(options.pre_run_exec);
+  // Set environment first so pre-run program inherits it
+  timeline_begin("setup_environment");
+  setup_environment();
+  timeline_end();
 
-  // Optionally drop privileges
-  drop_privileges();
+  // Let the JVM know how many times it has been restarted
+  char *envvar;
+  OK_OR_FATAL(asprintf(&envvar, "studs.restarts=%d", restart_total()), "asprintf failed");
+  putenv(envvar);
+
+  // Mounts, network and cgroups are left up across restarts
+  if (!restart) setup_system();
+
+  // Apply jvm.sched and move into jvm cgroup before dropping
+  // privileges, since both require root
+  jvm_set_sched();
+  cgroup_enter("jvm");
 
   // build up jvm command line
   char fanexec_path[FANINIT_PATH_MAX];
   sprintf(fanexec_path, "%s/bin/java", JAVA_HOME);
   char *exec_path = fanexec_path;
-  char *exec_argv[32];
-  int arg = 0;
-  exec_argv[arg++] = "java";
+  struct arglist args = {0};
+  arglist_add(&args, "java");
 
   // sys.jar path
   char sys_jar_path[FANINIT_PATH_MAX];
@@ -199,27 +295,35 @@ static void child()
   const char *fan_main = get_prop(props, "main", NULL);
   if (fan_main == NULL) fatal("main prop not defined");
 
-  // configure max heap size
-  char jvm_xmx_arg[64];
-  const char *jvm_xmx = get_prop(props, "jvm.xmx", NULL);
-  if (jvm_xmx != NULL)
-  {
-    sprintf(jvm_xmx_arg, "-Xmx%s", jvm_xmx);
-    exec_argv[arg++] = jvm_xmx_arg;
-  }
+  // heap, gc, compiler and other tuning options from faninit.props
+  jvm_add_options(&args);
 
   // TODO: bb requires -XX:-AssumeMP to boot properly under java 11
   const char *sys_name = get_prop(sys_props, "system.name", NULL);
-  if (strcmp(sys_name, "bb") == 0) exec_argv[arg++] = "-XX:-AssumeMP";
+  if (sys_name != NULL && strcmp(sys_name, "bb") == 0) arglist_add(&args, "-XX:-AssumeMP");
+
+  // map class data sharing archive; -Xshare:auto falls back to
+  // normal class loading if archive does not match this JVM
+  const char *jvm_cds = get_prop(props, "jvm.cds.archive", NULL);
+  if (jvm_cds != NULL && setup_cds(jvm_cds, sys_jar_path, &args))
+  {
+    if (get_prop(props, "jvm.share", NULL) == NULL) arglist_add(&args, "-Xshare:auto");
+    arglist_addf(&args, "-XX:SharedArchiveFile=%s", jvm_cds);
+  }
+
+  // Optionally drop privileges; done after any CDS dump so the
+  // archive can be written to a root owned directory
+  drop_privileges();
 
   // TEMP: for debugging TLS
-  // exec_argv[arg++] = "-Djavax.net.debug=all";
+  // arglist_add(&args, "-Djavax.net.debug=all");
 
-  exec_argv[arg++] = "-cp";
-  exec_argv[arg++] = sys_jar_path;
-  exec_argv[arg++] = "fanx.tools.Fan";
-  exec_argv[arg++] = strdup(fan_main);
-  exec_argv[arg] = NULL;
+  arglist_add(&args, "-cp");
+  arglist_add(&args, sys_jar_path);
+  arglist_add(&args, "fanx.tools.Fan");
+  arglist_add(&args, fan_main);
+  char **exec_argv = args.argv;
+  int arg = args.argc;
 
   if (options.verbose)
   {
@@ -234,13 +338,20 @@ static void child()
       debug("Arg: '%s'", exec_argv[i]);
 
     // dump faninit props
-    struct prop *p = props;
+    struct prop *p = props ? props->head : NULL;
     for (; p !=NULL; p=p->next)
       debug("Prop: '%s=%s'", p->name, p->val);
   }
 
   debug("Launching Fantom...");
-  if (options.print_timing) warn("stop");
+
+  // record jvm launch and write timeline now that /run is mounted;
+  // a restart keeps the timeline from boot
+  if (!restart)
+  {
+    timeline_begin("exec");
+    timeline_write();
+  }
 
   // start jvm
   chdir(FAN_HOME);
@@ -321,6 +432,34 @@ static void kill_all()
   sync();
 }
 
+/*
+ * Kill the processes the JVM started, which are in the jvm and
+ * helpers cgroups, while leaving daemons started by the pre-run
+ * program running since they are not relaunched on restart.
+ */
+static void kill_jvm_procs()
+{
+  debug("kill_jvm_procs");
+
+  int jvm = cgroup_signal("jvm", SIGTERM);
+  int helpers = cgroup_signal("helpers", SIGTERM);
+  if (jvm < 0 && helpers < 0)
+  {
+    warn("cgroups not available; processes started by the JVM are left running");
+    return;
+  }
+
+  // Brutal kill the stragglers
+  if (jvm > 0 || helpers > 0)
+  {
+    watchdog_ping();
+    sleep(1);
+    cgroup_signal("jvm", SIGKILL);
+    cgroup_signal("helpers", SIGKILL);
+    usleep(100000);
+  }
+}
+
 int main(int argc, char *argv[])
 {
   // sanity check
@@ -328,20 +467,19 @@ int main(int argc, char *argv[])
     fatal("Refusing to run since not pid 1");
 
   // Merge the config file and the command line arguments
+  timeline_begin("merge_config");
   static int merged_argc;
   static char *merged_argv[MAX_ARGC];
   merge_config(argc, argv, &merged_argc, merged_argv);
 
   parse_args(merged_argc, merged_argv);
+  timeline_end();
 
   // TODO FIXIT: read_faninit_props too late to set debug flag
   // need to move up earlier in startup process when erloptions
   // support is fully replaced
   options.verbose = 1;
 
-  if (options.print_timing)
-    warn("start");
-
   debug("Starting " PROGRAM_NAME " " PROGRAM_VERSION_STR "...");
 
   debug("cmdline argc=%d, merged argc=%d", argc, merged_argc);
@@ -350,51 +488,125 @@ int main(int argc, char *argv[])
     debug("merged argv[%d]=%s", i, merged_argv[i]);
 
   // read props
+  timeline_begin("read_props");
   read_sys_props();
   read_faninit_props();
 
+  // Start pinging the watchdog before setup so a hang during
+  // boot also resets the board
+  timeline_begin("watchdog");
+  watchdog_open();
+
   // Mount /dev, /proc and /sys
+  timeline_begin("setup_pseudo_filesystems");
   setup_pseudo_filesystems();
 
+  // Crash records need /sys for pstore
+  crash_init();
+
   // Fix the terminal settings so output goes to the right
   // terminal and the CTRL keys work in the shell..
+  timeline_begin("set_ctty");
   set_ctty();
 
   // Do most of the work in a child process so that if it
-  // crashes, we can handle the crash.
+  // crashes, we can handle the crash. The child inherits
+  // the timeline and ends the fork phase.
+  timeline_begin("fork");
+  restart_init();
+  crash_launched();
   pid_t pid = fork();
   if (pid == 0)
   {
-    child();
+    child(0);
     exit(1);
   }
 
   // Register signal handlers to catch requests to exit
   register_signal_handlers();
 
-  // Wait on Erlang until it exits or we receive a signal.
+  // Wait on the JVM until it exits or we receive a signal. If
+  // the watchdog is enabled the JVM must also send heartbeats.
+  // An unexpected exit relaunches the JVM in place until the
+  // restart policy is exhausted.
   int is_intentional_exit = 0;
-  if (waitpid(pid, 0, 0) < 0)
+  for (;;)
   {
-    debug("signal or error terminated waitpid. clean up");
+    int status = 0;
+    if (watchdog_wait(pid, &status) < 0)
+    {
+      debug("signal or error terminated waitpid. clean up");
+      if (desired_reboot_cmd != 0)
+      {
+        // A signal is sent from commands like poweroff, reboot, and halt
+        // This is usually intentional.
+        is_intentional_exit = 1;
+      }
+      else
+      {
+        // If waitpid returns error and it wasn't from a handled signal, print a warning.
+        warn("unexpected error from waitpid(): %s", strerror(errno));
+        desired_reboot_cmd = options.unintentional_exit_cmd;
+      }
+      break;
+    }
+
+    debug("Java VM exited");
     if (desired_reboot_cmd != 0)
     {
-      // A signal is sent from commands like poweroff, reboot, and halt
-      // This is usually intentional.
+      // Signal arrived while the JVM was exiting
       is_intentional_exit = 1;
+      break;
     }
+
+    // Record why the JVM exited before anything is unmounted
+    if (watchdog_stalled())
+      crash_record(CRASH_WATCHDOG, WTERMSIG(status));
+    else if (WIFSIGNALED(status))
+      crash_record(CRASH_SIGNAL, WTERMSIG(status));
     else
+      crash_record(CRASH_EXIT, WEXITSTATUS(status));
+
+    int delay = restart_next();
+    if (delay < 0)
     {
-      // If waitpid returns error and it wasn't from a handled signal, print a warning.
-      warn("unexpected error from waitpid(): %s", strerror(errno));
-      desired_reboot_cmd = options.unintentional_exit_cmd;
+      // A request that arrived while recording still wins
+      if (desired_reboot_cmd != 0) is_intentional_exit = 1;
+      else desired_reboot_cmd = options.unintentional_exit_cmd;
+      break;
+    }
+
+    // Stop processes left behind by the old JVM and reap them
+    warn("Restarting Java VM in %ds", delay);
+    kill_jvm_procs();
+    while (waitpid(-1, NULL, WNOHANG) > 0) {}
+
+    // A reboot, halt or poweroff request while stopping processes
+    // or backing off wins; keep the watchdog fed while waiting
+    int i;
+    for (i=0; i<delay && desired_reboot_cmd == 0; i++)
+    {
+      watchdog_ping();
+      sleep(1);
+    }
+    if (desired_reboot_cmd != 0)
+    {
+      is_intentional_exit = 1;
+      break;
+    }
+
+    crash_launched();
+    pid = fork();
+    if (pid == 0)
+    {
+      child(1);
+      exit(1);
     }
   }
-  else
-  {
-    debug("Java VM exited");
-    desired_reboot_cmd = options.unintentional_exit_cmd;
-  }
+
+  // Nothing pings the watchdog from here on, so stop it before the
+  // exit command, kill and unmount steps and the hang delay
+  watchdog_disarm();
 
   // If the user specified a command to run on an unexpected exit, run it.
   if (options.run_on_exit && !is_intentional_exit)
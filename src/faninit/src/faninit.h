@@ -12,6 +12,10 @@
 #ifndef FANINIT_H
 #define FANINIT_H
 
+#include <sched.h>
+#include <stdint.h>
+#include <sys/types.h>
+
 #define PROGRAM_NAME "faninit"
 #ifndef PROGRAM_VERSION
 #define PROGRAM_VERSION unknown
@@ -25,6 +29,11 @@
 #define FANINIT_PROPS "/etc/faninit.props"
 #define FAN_HOME "/app/fan"
 #define JAVA_HOME "/app/jre"
+#define BOOT_TIMELINE "/run/faninit.timeline"
+#define CDS_CLASSLIST "/app/cds/classes.lst"
+#define CGROUP_ROOT "/sys/fs/cgroup"
+#define WATCHDOG_DEVICE "/dev/watchdog"
+#define WATCHDOG_FIFO "/run/faninit.watchdog"
 
 // This is the maximum number of mounted filesystems that
 // is expected in a running system. It is used on shutdown
@@ -33,20 +42,35 @@
 
 #define MAX_ARGC 32
 
+// Maximum number of setup tasks run concurrently before the JVM
+// is launched. Must fit in the task dependency bitmask.
+#define MAX_TASKS 48
+
 // PATH_MAX wasn't in the musl include files, so rather
 // than pulling an arbitrary number in from linux/limits.h,
 // just define to something that should be trivially safe
 // for faninit use.
 #define FANINIT_PATH_MAX 1024
 
+#define PROPS_BUCKETS 64
+
 struct prop {
   const char* name;
   const char* val;
-  struct prop* next;
+  struct prop* next;        // next in file order
+  struct prop* hash_next;   // next in bucket
 };
 
-struct prop* sys_props;
-struct prop* props;
+struct props {
+  struct prop* head;
+  struct prop* tail;
+  struct prop* buckets[PROPS_BUCKETS];
+  int size;
+  char* buf;                // storage for names and values
+};
+
+extern struct props* sys_props;
+extern struct props* props;
 
 struct erlinit_options {
   int verbose;
@@ -78,8 +102,15 @@ void fatal(const char *fmt, ...);
 #define OK_OR_WARN(WORK, MSG, ...) do { if ((WORK) < 0) warn(MSG, ## __VA_ARGS__); } while (0)
 
 // Props
-struct prop* read_props(const char* filename);
-const char* get_prop(struct prop* props, const char* name, const char* def);
+struct props* read_props(const char* filename);
+void free_props(struct props* p);
+const char* get_prop(struct props* p, const char* name, const char* def);
+int get_prop_int(struct props* p, const char* name, int def, int min, int max);
+void export_props(struct props* p, const char* prefix);
+
+// Monotonic clock
+uint64_t now_us();
+uint64_t now_ms();
 
 // Configuration loading
 void merge_config(int argc, char *argv[], int *merged_argc, char **merged_argv);
@@ -87,16 +118,82 @@ void merge_config(int argc, char *argv[], int *merged_argc, char **merged_argv);
 // Argument parsing
 void parse_args(int argc, char *argv[]);
 
+// Setup tasks
+typedef void (*task_func)(const void *arg);
+int task_add(const char *name, task_func func, const void *arg);
+void task_dep(int task, int dep);
+void task_run_all();
+
 // Networking
-void setup_networking();
+void add_networking_tasks();
 
 // Filesystems
 void setup_pseudo_filesystems();
-void setup_filesystems();
+void add_filesystem_tasks();
 void unmount_all();
 
 // Terminal
 void set_ctty();
 void warn_unused_tty();
 
+// JVM options
+struct arglist {
+  char **argv;    // NULL terminated
+  int argc;
+  int cap;
+};
+
+void arglist_add(struct arglist *a, const char *arg);
+void arglist_addf(struct arglist *a, const char *fmt, ...);
+void jvm_add_options(struct arglist *a);
+
+// Cgroups
+void setup_cgroups();
+void cgroup_enter(const char *name);
+int cgroup_signal(const char *name, int sig);
+
+// Scheduling
+struct sched_spec {
+  int policy;       // SCHED_xxx
+  int has_policy;
+  int value;        // nice for normal policies or realtime priority
+  int has_value;
+  cpu_set_t cpus;
+  int has_cpus;
+};
+
+int parse_sched(const char *s, struct sched_spec *spec);
+int apply_sched(pid_t pid, const struct sched_spec *spec);
+void jvm_set_sched();
+
+// Watchdog
+void watchdog_open();
+void watchdog_setup_fifo();
+void watchdog_ping();
+void watchdog_disarm();
+int watchdog_stalled();
+pid_t watchdog_wait(pid_t pid, int *status);
+
+// Restart policy
+void restart_init();
+int restart_next();
+int restart_total();
+
+// Crash records
+#define CRASH_RECORD_SIZE 1024
+#define CRASH_EXIT        0   // JVM exited; code is exit status
+#define CRASH_SIGNAL      1   // JVM killed; code is signal
+#define CRASH_WATCHDOG    2   // JVM killed by watchdog; code is signal
+
+void crash_init();
+void crash_launched();
+void crash_record(int reason, int code);
+
+// Boot timeline
+int timeline_open(const char *name);
+void timeline_close(int index);
+void timeline_begin(const char *name);
+void timeline_end();
+void timeline_write();
+
 #endif // FANINIT_H
@@ -85,23 +85,93 @@ void setup_pseudo_filesystems()
 #endif
 }
 
-void setup_filesystems()
+struct mount_spec {
+    const char *source;
+    const char *target;
+    const char *filesystemtype;
+    char *mountflags;
+    const char *data;
+    int task;
+};
+
+static struct mount_spec mount_specs[MAX_MOUNTS];
+static int num_mount_specs = 0;
+
+static void mount_tmp(const void *arg)
 {
+    (void) arg;
 #ifndef UNITTEST
     // Mount /tmp and /run since they're almost always needed and it's
     // not easy to do it at the right time in Erlang.
     if (mount("", "/tmp", "tmpfs", 0, "mode=1777,size=10%") < 0)
         warn("Could not mount tmpfs in /tmp: %s\r\n"
              "Check that tmpfs support is enabled in the kernel config.", strerror(errno));
+#endif
+}
 
+static void mount_run(const void *arg)
+{
+    (void) arg;
+#ifndef UNITTEST
     if (mount("", "/run", "tmpfs", MS_NOSUID | MS_NODEV, "mode=0755,size=5%") < 0)
         warn("Could not mount tmpfs in /run: %s", strerror(errno));
 #endif
+}
+
+static void mount_extra(const void *arg)
+{
+    const struct mount_spec *m = arg;
+#ifndef UNITTEST
+    unsigned long imountflags = str_to_mountflags(m->mountflags);
+    if (mount(m->source, m->target, m->filesystemtype, imountflags, m->data) < 0)
+        warn("Cannot mount %s at %s: %s", m->source, m->target, strerror(errno));
+#else
+    warn("Cannot mount %s at %s: %s", m->source, m->target, "regression test");
+#endif
+}
+
+static int add_mount(const char *name, task_func func, struct mount_spec *m)
+{
+    m->task = task_add(name, func, m);
+
+    // A mount nested under an earlier target must wait for it,
+    // otherwise it would be hidden by the parent mount.
+    int i;
+    size_t len = strlen(m->target);
+    for (i = 0; i < num_mount_specs; i++) {
+        struct mount_spec *p = &mount_specs[i];
+        size_t plen = strlen(p->target);
+        if (p == m || plen >= len)
+            continue;
+        if (strncmp(p->target, m->target, plen) == 0 &&
+                (m->target[plen] == '/' || p->target[plen-1] == '/'))
+            task_dep(m->task, p->task);
+    }
+    return m->task;
+}
+
+void add_filesystem_tasks()
+{
+    num_mount_specs = 0;
+
+    // /tmp and /run are always mounted; the run mount is tracked so
+    // extra mounts below it are ordered after it
+    struct mount_spec *tmp = &mount_specs[num_mount_specs++];
+    memset(tmp, 0, sizeof(*tmp));
+    tmp->target = "/tmp";
+    add_mount("mount:/tmp", mount_tmp, tmp);
+
+    struct mount_spec *run = &mount_specs[num_mount_specs++];
+    memset(run, 0, sizeof(*run));
+    run->target = "/run";
+    add_mount("mount:/run", mount_run, run);
 
     // Mount any filesystems specified by the user. This is best effort.
     // The user is required to figure out if anything went wrong in their
     // applications. For example, the filesystem might not be formatted
-    // yet, and erlinit is not smart enough to figure that out.
+    // yet, and erlinit is not smart enough to figure that out.  Each
+    // mount runs as its own task so mounts on different devices do not
+    // wait on each other.
     //
     // An example mount specification looks like:
     //    /dev/mmcblk0p4:/mnt:vfat::utf8
@@ -115,14 +185,21 @@ void setup_filesystems()
         const char *data = strsep(&temp, ";"); // multi-mount separator
 
         if (source && target && filesystemtype && mountflags && data) {
-#ifndef UNITTEST
-            unsigned long imountflags =
-                    str_to_mountflags(mountflags);
-            if (mount(source, target, filesystemtype, imountflags, data) < 0)
-                warn("Cannot mount %s at %s: %s", source, target, strerror(errno));
-#else
-            warn("Cannot mount %s at %s: %s", source, target, "regression test");
-#endif
+            if (num_mount_specs == MAX_MOUNTS) {
+                warn("Too many mounts; ignoring %s", target);
+                continue;
+            }
+            struct mount_spec *m = &mount_specs[num_mount_specs++];
+            m->source = source;
+            m->target = target;
+            m->filesystemtype = filesystemtype;
+            m->mountflags = mountflags;
+            m->data = data;
+
+            char *name;
+            if (asprintf(&name, "mount:%s", target) < 0)
+                fatal("asprintf failed");
+            add_mount(name, mount_extra, m);
         } else {
             warn("Invalid parameter to -m. Expecting 5 colon-separated fields");
         }
@@ -0,0 +1,205 @@
+/*
+// Copyright (c) 2026, Andy Frank
+// Licensed under the Apache License version 2.0
+//
+// History:
+//   19 Oct 2026  Andy Frank  Creation
+*/
+
+#include "faninit.h"
+
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//////////////////////////////////////////////////////////////////////////
+// Arglist
+//////////////////////////////////////////////////////////////////////////
+
+void arglist_add(struct arglist *a, const char *arg)
+{
+  // keep room for terminating NULL
+  if (a->argc + 2 > a->cap)
+  {
+    a->cap  = a->cap == 0 ? 16 : a->cap * 2;
+    a->argv = realloc(a->argv, a->cap * sizeof(char *));
+    if (a->argv == NULL) fatal("realloc failed");
+  }
+
+  a->argv[a->argc++] = strdup(arg);
+  a->argv[a->argc] = NULL;
+}
+
+void arglist_addf(struct arglist *a, const char *fmt, ...)
+{
+  char *arg;
+  va_list ap;
+  va_start(ap, fmt);
+  int rc = vasprintf(&arg, fmt, ap);
+  va_end(ap);
+  if (rc < 0) fatal("vasprintf failed");
+
+  arglist_add(a, arg);
+  free(arg);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Options
+//////////////////////////////////////////////////////////////////////////
+
+#define OPT_SIZE  0   // memory size such as 384m
+#define OPT_INT   1   // integer in [min, max]
+#define OPT_ENUM  2   // one of choices
+
+struct jvm_choice
+{
+  const char *val;
+  const char *arg;
+};
+
+struct jvm_opt
+{
+  const char *name;                   // faninit.props name
+  int type;
+  const char *fmt;                    // arg format for SIZE and INT
+  int min, max;                       // range for INT
+  const struct jvm_choice *choices;   // NULL terminated for ENUM
+};
+
+static const struct jvm_choice gc_choices[] = {
+  { "serial",   "-XX:+UseSerialGC"   },
+  { "parallel", "-XX:+UseParallelGC" },
+  { "g1",       "-XX:+UseG1GC"       },
+  { NULL, NULL }
+};
+
+static const struct jvm_choice share_choices[] = {
+  { "auto", "-Xshare:auto" },
+  { "on",   "-Xshare:on"   },
+  { "off",  "-Xshare:off"  },
+  { NULL, NULL }
+};
+
+static const struct jvm_choice numa_choices[] = {
+  { "true",  "-XX:+UseNUMA" },
+  { "false", "-XX:-UseNUMA" },
+  { NULL, NULL }
+};
+
+// Known JVM options in the order they are passed to java
+static const struct jvm_opt jvm_opts[] = {
+  { "jvm.xms",         OPT_SIZE, "-Xms%s",                       0, 0, NULL },
+  { "jvm.xmx",         OPT_SIZE, "-Xmx%s",                       0, 0, NULL },
+  { "jvm.xss",         OPT_SIZE, "-Xss%s",                       0, 0, NULL },
+  { "jvm.metaspace",   OPT_SIZE, "-XX:MaxMetaspaceSize=%s",      0, 0, NULL },
+  { "jvm.codecache",   OPT_SIZE, "-XX:ReservedCodeCacheSize=%s", 0, 0, NULL },
+  { "jvm.gc",          OPT_ENUM, NULL,                           0, 0, gc_choices },
+  { "jvm.tiered.stop", OPT_INT,  "-XX:TieredStopAtLevel=%s",     0, 4, NULL },
+  { "jvm.cpus",        OPT_INT,  "-XX:ActiveProcessorCount=%s",  1, 1024, NULL },
+  { "jvm.numa",        OPT_ENUM, NULL,                           0, 0, numa_choices },
+  { "jvm.share",       OPT_ENUM, NULL,                           0, 0, share_choices },
+  { NULL, 0, NULL, 0, 0, NULL }
+};
+
+// Props under jvm. handled outside of jvm_opts
+static const char *jvm_other_props[] = {
+  "jvm.cds.archive",
+  "jvm.cds.dump",
+  "jvm.sched",
+  NULL
+};
+
+/*
+ * Return true if 's' is a memory size: digits with an
+ * optional k, m or g suffix.
+ */
+static int is_size(const char *s)
+{
+  const char *p = s;
+  while (isdigit((unsigned char)*p)) p++;
+  if (p == s) return 0;
+  if (*p != '\0' && strchr("kKmMgG", *p) != NULL) p++;
+  return *p == '\0';
+}
+
+/*
+ * Return true if 's' is an integer in [min, max].
+ */
+static int is_int(const char *s, int min, int max)
+{
+  char *end;
+  if (*s == '\0') return 0;
+  long v = strtol(s, &end, 10);
+  return *end == '\0' && v >= min && v <= max;
+}
+
+/*
+ * Add the arg for option 'o' with value 'val', or return -1
+ * if value is invalid.
+ */
+static int add_opt(struct arglist *a, const struct jvm_opt *o, const char *val)
+{
+  switch (o->type)
+  {
+    case OPT_SIZE:
+      if (!is_size(val)) return -1;
+      arglist_addf(a, o->fmt, val);
+      return 0;
+
+    case OPT_INT:
+      if (!is_int(val, o->min, o->max)) return -1;
+      arglist_addf(a, o->fmt, val);
+      return 0;
+
+    case OPT_ENUM:
+    {
+      const struct jvm_choice *c;
+      for (c = o->choices; c->val != NULL; c++)
+      {
+        if (strcmp(c->val, val) != 0) continue;
+        arglist_add(a, c->arg);
+        return 0;
+      }
+      return -1;
+    }
+  }
+  return -1;
+}
+
+/*
+ * Return true if 'name' is a known jvm prop.
+ */
+static int is_jvm_prop(const char *name)
+{
+  const struct jvm_opt *o;
+  for (o = jvm_opts; o->name != NULL; o++)
+    if (strcmp(o->name, name) == 0) return 1;
+
+  const char **n;
+  for (n = jvm_other_props; *n != NULL; n++)
+    if (strcmp(*n, name) == 0) return 1;
+
+  return 0;
+}
+
+void jvm_add_options(struct arglist *a)
+{
+  // warn on unknown options so typos do not go unnoticed
+  struct prop *p;
+  for (p = props ? props->head : NULL; p != NULL; p = p->next)
+  {
+    if (strncmp(p->name, "jvm.", 4) != 0) continue;
+    if (!is_jvm_prop(p->name)) warn("Unknown JVM option '%s'", p->name);
+  }
+
+  // invalid values are skipped so a bad option does not prevent boot
+  const struct jvm_opt *o;
+  for (o = jvm_opts; o->name != NULL; o++)
+  {
+    const char *val = get_prop(props, o->name, NULL);
+    if (val == NULL) continue;
+    if (add_opt(a, o, val) < 0) warn("Invalid value for %s: '%s'", o->name, val);
+  }
+}
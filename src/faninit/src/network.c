@@ -204,11 +204,24 @@ cleanup:
 #endif
 }
 
-void setup_networking()
+static void run_loopback(const void *arg)
 {
-    debug("setup_networking");
-
-    // Bring up the loopback interface (needed if the erlang distribute protocol code gets run)
+    (void) arg;
     enable_loopback();
+}
+
+static void run_hostname(const void *arg)
+{
+    (void) arg;
     configure_hostname();
 }
+
+void add_networking_tasks()
+{
+    debug("add_networking_tasks");
+
+    // Bring up the loopback interface (needed if the erlang distribute protocol code gets run)
+    // and set the hostname independently, since uniqueid_exec may be slow.
+    task_add("loopback", run_loopback, NULL);
+    task_add("hostname", run_hostname, NULL);
+}
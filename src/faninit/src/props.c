@@ -8,45 +8,35 @@
 
 #include "faninit.h"
 
-#include <stdlib.h>
+#include <fcntl.h>
+#include <stdint.h>
 #include <stdio.h>
-#include <assert.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 
-// push back for read
-int unread = 0;
+#include <sys/mman.h>
+#include <sys/stat.h>
 
-/**
- * Read next character from stream or return EOF
- */
-int read_char(FILE* fp)
-{
-  if (unread != 0)
-  {
-    int c = unread;
-    unread = 0;
-    return c;
-  }
-  else
-  {
-    return fgetc(fp);
-  }
-}
+struct props* sys_props = NULL;
+struct props* props = NULL;
 
 /**
- * Pushback a character to reuse for next read_char()
+ * FNV-1a hash of null-terminated string.
  */
-void unread_char(int ch)
+static uint32_t hash(const char *s)
 {
-  assert(unread == 0);
-  unread = ch;
+  uint32_t h = 2166136261u;
+  while (*s) { h ^= (unsigned char)*s++; h *= 16777619u; }
+  return h;
 }
 
 /**
  * Convert a hexadecimal digit char into its numeric
  * value or return -1 on error.
  */
-int hex(int c)
+static int hex(int c)
 {
   if ('0' <= c && c <= '9') return c - '0';
   if ('a' <= c && c <= 'f') return c - 'a' + 10;
@@ -57,131 +47,176 @@ int hex(int c)
 /**
  * Return if specified character is whitespace.
  */
-int is_space(int c)
+static int is_space(int c)
 {
   return c == ' ' || c == '\t';
 }
 
 /**
- * Given a pointer to a string of characters, trim the leading
- * and trailing whitespace and return a copy of the string from
- * heap memory.
+ * Trim leading and trailing whitespace from the 'len' chars
+ * at 's' and null-terminate in place. Returns start of the
+ * trimmed string.
  */
-char* make_trim_copy(char* s, int num)
+static char* trim(char *s, int len)
 {
-  // trim leading/trailing whitespace
-  int start = 0;
-  int end = num;
-  while (start < end) if (is_space(s[start])) start++; else break;
-  while (end > start) if (is_space(s[end-1])) end--; else break;
-  s[end] = '\0';
-  s = s+start;
-
-  // make copy on heap
-  char* copy = (char *)malloc(end-start+1);
-  strcpy(copy, s);
-  return copy;
+  while (len > 0 && is_space(s[len-1])) len--;
+  s[len] = '\0';
+  while (is_space(*s)) s++;
+  return s;
+}
+
+/**
+ * Encode unicode code point 'c' as UTF-8 into 'out' and
+ * return number of bytes written.
+ */
+static int utf8(int c, char *out)
+{
+  if (c < 0x80) { out[0] = c; return 1; }
+  if (c < 0x800)
+  {
+    out[0] = 0xc0 | (c >> 6);
+    out[1] = 0x80 | (c & 0x3f);
+    return 2;
+  }
+  out[0] = 0xe0 | (c >> 12);
+  out[1] = 0x80 | ((c >> 6) & 0x3f);
+  out[2] = 0x80 | (c & 0x3f);
+  return 3;
+}
+
+/**
+ * Add or replace name/value pair.  Name and val are owned by
+ * the 'p->buf' storage and are not copied.
+ */
+static void put_prop(struct props *p, char *name, char *val)
+{
+  uint32_t b = hash(name) % PROPS_BUCKETS;
+  struct prop *x = p->buckets[b];
+  for (; x != NULL; x = x->hash_next)
+  {
+    // last value wins as with sys::InStream.readProps
+    if (strcmp(x->name, name) == 0) { x->val = val; return; }
+  }
+
+  x = (struct prop *)malloc(sizeof(struct prop));
+  if (x == NULL) fatal("malloc failed");
+  x->name = name;
+  x->val  = val;
+  x->next = NULL;
+  x->hash_next = p->buckets[b];
+  p->buckets[b] = x;
+
+  if (p->head == NULL) p->head = p->tail = x;
+  else { p->tail->next = x; p->tail = x; }
+  p->size++;
 }
 
 /**
  * Parse the specified props file according to the file format
- * specified by sys::InStream - this is pretty much a C port of
- * the Java implementation.  Return a linked list of Props or if
- * error, then print error to stdout and return NULL.
+ * specified by sys::InStream.readProps.  The file is mapped and
+ * tokenized in a single pass; names and values are unescaped into
+ * one heap buffer the size of the file, so there is no limit on
+ * name or value length.  Return the parsed props, or if error,
+ * then print error to stderr and return NULL.
  */
-struct prop* read_props(const char* filename)
+struct props* read_props(const char* filename)
 {
-  char name[512];
-  char val[4096];
-  int name_num = 0, val_num = 0;
-  int in_val = 0;
-  int in_block_comment = 0;
-  int in_end_of_line_comment = 0;
-  int c = -1, last = -1;
-  int line_num = 1;
-  FILE* fp;
-  struct prop* head = NULL;
-  struct prop* tail = NULL;
+  int fd = open(filename, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) fatal("%s not found", filename);
+
+  struct stat st;
+  if (fstat(fd, &st) < 0) fatal("fstat %s failed", filename);
+  size_t size = st.st_size;
 
-  fp = fopen(filename, "r");
-  if (fp == NULL) fatal("/etc/faninit.props not found");
+  const char *s = "";
+  if (size > 0)
+  {
+    s = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (s == MAP_FAILED) fatal("mmap %s failed", filename);
+  }
+  close(fd);
+
+  struct props *p = (struct props *)calloc(1, sizeof(struct props));
+  char *buf = (char *)malloc(size + 1);
+  if (p == NULL || buf == NULL) fatal("malloc failed");
+  p->buf = buf;
+
+  // output cursor into buf; 'name' is the start of the current
+  // token, 'val' is the start of the value if we've seen '='
+  char *out  = buf;
+  char *name = buf;
+  char *val  = NULL;
+  int block_comment = 0;
+  int line_num = 1;
+  size_t i = 0;
 
-  for (;;)
+  while (i <= size)
   {
-    last = c;
-    c = read_char(fp);
-    if (c == EOF) break;
+    int c = i < size ? s[i] : '\n';
+    i++;
 
-    // end of line
+    // end of line or end of file
     if (c == '\n' || c == '\r')
     {
-      in_end_of_line_comment = 0;
-      if (last == '\r' && c == '\n') continue;
-      char* n = make_trim_copy(name, name_num);
-      if (in_val)
-      {
-        char* v = make_trim_copy(val, val_num);
-
-        struct prop* p = (struct prop *)malloc(sizeof(struct prop));
-        p->name = n;
-        p->val = v;
-        p->next = NULL;
-        if (head == NULL) { head = tail = p; }
-        else { tail->next = p; tail = p; }
+      if (c == '\r' && i < size && s[i] == '\n') i++;
 
-        in_val = 0;
-        name_num = val_num = 0;
+      if (val != NULL)
+      {
+        char *n = trim(name, (val - 1) - name);
+        char *v = trim(val, out - val);
+        put_prop(p, n, v);
+        out++;
       }
-      else if (strlen(n) > 0)
+      else if (*trim(name, out - name) != '\0')
       {
-        warn("Invalid name/value pair [%s:%d]\n", filename, line_num);
-        return NULL;
+        warn("Invalid name/value pair [%s:%d]", filename, line_num);
+        goto fail;
       }
+
+      name = out;
+      val  = NULL;
       line_num++;
       continue;
     }
 
-    // if in comment
-    if (in_end_of_line_comment) continue;
-
     // block comment
-    if (in_block_comment > 0)
+    if (block_comment > 0)
     {
-      if (last == '/' && c == '*') in_block_comment++;
-      if (last == '*' && c == '/') in_block_comment--;
+      if (c == '/' && i < size && s[i] == '*') { block_comment++; i++; }
+      else if (c == '*' && i < size && s[i] == '/') { block_comment--; i++; }
       continue;
     }
 
     // equal
-    if (c == '=' && !in_val)
+    if (c == '=' && val == NULL)
     {
-      in_val = 1;
+      // terminate name; value starts after it
+      *out++ = '\0';
+      val = out;
       continue;
     }
 
-    // bash-style comment
-    if (c == '#')
+    // bash-style or c-style end of line comment
+    if (c == '#' || (c == '/' && i < size && s[i] == '/'))
     {
-      in_end_of_line_comment = 1;
+      while (i < size && s[i] != '\n' && s[i] != '\r') i++;
       continue;
     }
 
-    // c-style comment
-    if (c == '/')
+    // c-style block comment
+    if (c == '/' && i < size && s[i] == '*')
     {
-      int peek = read_char(fp);
-      if (peek < 0) break;
-      if (peek == '/') { in_end_of_line_comment = 1; continue; }
-      if (peek == '*') { in_block_comment++; continue; }
-      unread_char(peek);
+      block_comment++;
+      i++;
+      continue;
     }
 
     // escape or line continuation
     if (c == '\\')
     {
-      int peek = read_char(fp);
-      if (peek < 0) break;
-      else if (peek == 'n')  c = '\n';
+      if (i >= size) continue;
+      int peek = s[i++];
+      if (peek == 'n')       c = '\n';
       else if (peek == 'r')  c = '\r';
       else if (peek == 't')  c = '\t';
       else if (peek == '\\') c = '\\';
@@ -189,91 +224,128 @@ struct prop* read_props(const char* filename)
       {
         // line continuation
         line_num++;
-        if (peek == '\r')
-        {
-          peek = read_char(fp);
-          if (peek != '\n') unread_char(peek);
-        }
-        while (1)
-        {
-          peek = read_char(fp);
-          if (peek == ' ' || peek == '\t') continue;
-          unread_char(peek);
-          break;
-        }
+        if (peek == '\r' && i < size && s[i] == '\n') i++;
+        while (i < size && is_space(s[i])) i++;
         continue;
       }
       else if (peek == 'u')
       {
-        int n3 = hex(read_char(fp));
-        int n2 = hex(read_char(fp));
-        int n1 = hex(read_char(fp));
-        int n0 = hex(read_char(fp));
+        int n3 = i+0 < size ? hex(s[i+0]) : -1;
+        int n2 = i+1 < size ? hex(s[i+1]) : -1;
+        int n1 = i+2 < size ? hex(s[i+2]) : -1;
+        int n0 = i+3 < size ? hex(s[i+3]) : -1;
         if (n3 < 0 || n2 < 0 || n1 < 0 || n0 < 0)
         {
-          warn("Invalid hex value for \\uxxxx [%s:%d]\n", filename, line_num);
-          return NULL;
+          warn("Invalid hex value for \\uxxxx [%s:%d]", filename, line_num);
+          goto fail;
         }
-        c = ((n3 << 12) | (n2 << 8) | (n1 << 4) | n0);
+        i += 4;
+
+        // 6 input chars always fit the 3 byte encoding
+        out += utf8((n3 << 12) | (n2 << 8) | (n1 << 4) | n0, out);
+        continue;
       }
       else
       {
-        warn("Invalid escape sequence [%s:%d]\n", filename, line_num);
-        return NULL;
+        warn("Invalid escape sequence [%s:%d]", filename, line_num);
+        goto fail;
       }
     }
 
     // normal character
-    if (in_val)
-    {
-      if (val_num+1 < (int)sizeof(val)) val[val_num++] = c;
-    }
-    else
-    {
-      if (name_num+1 < (int)sizeof(name)) name[name_num++] = c;
-    }
+    *out++ = c;
   }
 
-  char* n = make_trim_copy(name, name_num);
-  if (in_val)
+  if (size > 0) munmap((void *)s, size);
+  return p;
+
+fail:
+  if (size > 0) munmap((void *)s, size);
+  free_props(p);
+  return NULL;
+}
+
+/**
+ * Free props returned from read_props.
+ */
+void free_props(struct props* p)
+{
+  if (p == NULL) return;
+  struct prop *x = p->head;
+  while (x != NULL)
   {
-    char* v = make_trim_copy(val, val_num);
-
-    struct prop* p = (struct prop *)malloc(sizeof(struct prop));
-    p->name = n;
-    p->val = v;
-    p->next = NULL;
-    if (head == NULL) { head = tail = p; }
-    else { tail->next = p; tail = p; }
+    struct prop *next = x->next;
+    free(x);
+    x = next;
   }
-  else if (strlen(n) > 0)
+  free(p->buf);
+  free(p);
+}
+
+/**
+ * Get a property value or return def if not found.
+ */
+const char* get_prop(struct props* p, const char* name, const char* def)
+{
+  if (p == NULL) return def;
+  struct prop *x = p->buckets[hash(name) % PROPS_BUCKETS];
+  for (; x != NULL; x = x->hash_next)
+    if (strcmp(x->name, name) == 0)
+      return x->val;
+  return def;
+}
+
+/**
+ * Get an integer property in the range 'min' to 'max', or 'def'
+ * if not found. Logs a warning and returns 'def' if invalid.
+ */
+int get_prop_int(struct props* p, const char* name, int def, int min, int max)
+{
+  const char *val = get_prop(p, name, NULL);
+  if (val == NULL) return def;
+
+  char *end;
+  long v = strtol(val, &end, 10);
+  if (end == val || *end != '\0' || v < min || v > max)
   {
-    warn("Invalid name/value pair [%s:%d]\n", filename, line_num);
-    return NULL;
+    warn("Invalid value for %s: '%s'", name, val);
+    return def;
   }
+  return (int)v;
+}
 
-  return head;
+/**
+ * Return monotonic time in microseconds, which on Linux counts
+ * from kernel start so marks line up with kernel log timestamps.
+ */
+uint64_t now_us()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
 }
 
 /**
- * Get a property from the linked list or return def if not found.
+ * Return monotonic time in milliseconds.
  */
-const char* get_prop(struct prop* props, const char* name, const char* def)
+uint64_t now_ms()
 {
-  struct prop *p = props;
-  for (; p != NULL; p = p->next)
-    if (strcmp(p->name, name) == 0)
-      return p->val;
-  return def;
+  return now_us() / 1000;
 }
 
 /**
- * Get a substring
+ * Export each property to the environment as '<prefix><name>'
+ * so the JVM can read them without parsing the file again.
  */
-char* substr(const char *src, int start, int len)
+void export_props(struct props* p, const char* prefix)
 {
-  char *sub = malloc((len+1) * sizeof(char));
-  memcpy(sub, &src[start], len);
-  sub[len] = '\0';
-  return sub;
+  if (p == NULL) return;
+  struct prop *x;
+  for (x = p->head; x != NULL; x = x->next)
+  {
+    char *envvar;
+    if (asprintf(&envvar, "%s%s=%s", prefix, x->name, x->val) < 0)
+      fatal("asprintf failed");
+    putenv(envvar);
+  }
 }
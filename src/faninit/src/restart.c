@@ -0,0 +1,66 @@
+/*
+// Copyright (c) 2026, Andy Frank
+// Licensed under the Apache License version 2.0
+//
+// History:
+//   19 Oct 2026  Andy Frank  Creation
+*/
+
+#include "faninit.h"
+
+#include <time.h>
+
+// Upper bound on the backoff delay in seconds
+#define RESTART_MAX_DELAY 60
+
+static int max_restarts = 0;    // restarts allowed per window; 0 to always exit
+static int window = 300;        // sec
+static int delay = 1;           // sec before first restart in window
+
+static int count = 0;           // restarts in current window
+static int total = 0;           // restarts since boot
+static time_t window_start = 0;
+
+void restart_init()
+{
+  max_restarts = get_prop_int(props, "exit.restart", max_restarts, 0, 86400);
+  window = get_prop_int(props, "exit.restart.window", window, 0, 86400);
+  delay  = get_prop_int(props, "exit.restart.delay", delay, 0, 86400);
+  if (max_restarts > 0)
+    debug("restart policy: %d per %ds, delay %ds", max_restarts, window, delay);
+}
+
+int restart_next()
+{
+  if (max_restarts == 0) return -1;
+
+  // the window starts at the first restart; a JVM that stays up
+  // past it starts over with a fresh budget
+  time_t now = now_ms() / 1000;
+  if (count == 0 || now - window_start > window)
+  {
+    count = 0;
+    window_start = now;
+  }
+
+  if (count == max_restarts)
+  {
+    warn("JVM restarted %d times in %ds; giving up", count, window);
+    return -1;
+  }
+
+  // exponential backoff within the window
+  int d = delay;
+  int i;
+  for (i=0; i<count && d < RESTART_MAX_DELAY; i++) d *= 2;
+  if (d > RESTART_MAX_DELAY) d = RESTART_MAX_DELAY;
+
+  count++;
+  total++;
+  return d;
+}
+
+int restart_total()
+{
+  return total;
+}
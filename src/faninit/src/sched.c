@@ -0,0 +1,168 @@
+/*
+// Copyright (c) 2026, Andy Frank
+// Licensed under the Apache License version 2.0
+//
+// History:
+//   19 Oct 2026  Andy Frank  Creation
+*/
+
+#include "faninit.h"
+
+#include <errno.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/resource.h>
+
+struct sched_policy_name
+{
+  const char *name;
+  int policy;
+};
+
+static const struct sched_policy_name policy_names[] = {
+  { "other", SCHED_OTHER },
+  { "batch", SCHED_BATCH },
+  { "idle",  SCHED_IDLE  },
+  { "fifo",  SCHED_FIFO  },
+  { "rr",    SCHED_RR    },
+  { NULL, 0 }
+};
+
+/*
+ * Parse a cpu list such as "0-2,4" into 'set'.
+ * Returns 0 on success or -1 if invalid.
+ */
+static int parse_cpus(const char *s, cpu_set_t *set)
+{
+  CPU_ZERO(set);
+  while (*s)
+  {
+    char *end;
+    long lo = strtol(s, &end, 10);
+    if (end == s || lo < 0 || lo >= CPU_SETSIZE) return -1;
+    long hi = lo;
+    if (*end == '-')
+    {
+      s = end + 1;
+      hi = strtol(s, &end, 10);
+      if (end == s || hi < lo || hi >= CPU_SETSIZE) return -1;
+    }
+
+    long i;
+    for (i=lo; i<=hi; i++) CPU_SET(i, set);
+
+    if (*end == ',') end++;
+    else if (*end != '\0') return -1;
+    s = end;
+  }
+  return CPU_COUNT(set) > 0 ? 0 : -1;
+}
+
+int parse_sched(const char *s, struct sched_spec *spec)
+{
+  memset(spec, 0, sizeof(*spec));
+  spec->policy = SCHED_OTHER;
+
+  char *copy = strdup(s);
+  char *cpus = strchr(copy, '@');
+  if (cpus != NULL) *cpus++ = '\0';
+  char *val = strchr(copy, ':');
+  if (val != NULL) *val++ = '\0';
+
+  int rc = -1;
+
+  // policy; may be omitted to only set cpus
+  if (copy[0] != '\0')
+  {
+    const struct sched_policy_name *p;
+    for (p = policy_names; p->name != NULL; p++)
+      if (strcmp(p->name, copy) == 0) break;
+    if (p->name == NULL) goto done;
+    spec->policy = p->policy;
+    spec->has_policy = 1;
+  }
+
+  // nice for normal policies or priority for realtime
+  if (val != NULL)
+  {
+    char *end;
+    spec->value = strtol(val, &end, 10);
+    if (end == val || *end != '\0') goto done;
+    if (spec->policy == SCHED_FIFO || spec->policy == SCHED_RR)
+    {
+      if (spec->value < 1 || spec->value > 99) goto done;
+    }
+    else if (spec->value < -20 || spec->value > 19) goto done;
+    spec->has_value = 1;
+  }
+  else if (spec->policy == SCHED_FIFO || spec->policy == SCHED_RR)
+  {
+    // realtime requires a priority
+    goto done;
+  }
+
+  if (cpus != NULL)
+  {
+    if (parse_cpus(cpus, &spec->cpus) < 0) goto done;
+    spec->has_cpus = 1;
+  }
+
+  rc = 0;
+
+done:
+  free(copy);
+  return rc;
+}
+
+int apply_sched(pid_t pid, const struct sched_spec *spec)
+{
+  int rc = 0;
+
+  if (spec->has_cpus && sched_setaffinity(pid, sizeof(spec->cpus), &spec->cpus) < 0)
+  {
+    warn("sched_setaffinity failed: %s", strerror(errno));
+    rc = -1;
+  }
+
+  if (spec->has_policy)
+  {
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    int rt = spec->policy == SCHED_FIFO || spec->policy == SCHED_RR;
+    if (rt) param.sched_priority = spec->value;
+    if (sched_setscheduler(pid, spec->policy, &param) < 0)
+    {
+      warn("sched_setscheduler failed: %s", strerror(errno));
+      rc = -1;
+    }
+  }
+
+  // nice only applies to normal policies
+  if (spec->has_value && spec->policy != SCHED_FIFO && spec->policy != SCHED_RR &&
+      setpriority(PRIO_PROCESS, pid, spec->value) < 0)
+  {
+    warn("setpriority failed: %s", strerror(errno));
+    rc = -1;
+  }
+
+  return rc;
+}
+
+void jvm_set_sched()
+{
+  const char *val = get_prop(props, "jvm.sched", NULL);
+  if (val == NULL) return;
+
+  struct sched_spec spec;
+  if (parse_sched(val, &spec) < 0)
+  {
+    warn("Invalid value for jvm.sched: '%s'", val);
+    return;
+  }
+
+  // applied to this process so the JVM and all its threads inherit it
+  debug("jvm.sched=%s", val);
+  apply_sched(0, &spec);
+}
@@ -0,0 +1,143 @@
+/*
+// Copyright (c) 2026, Andy Frank
+// Licensed under the Apache License version 2.0
+//
+// History:
+//   19 Oct 2026  Andy Frank  Creation
+*/
+
+#include "faninit.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/wait.h>
+
+#define TASK_PENDING  0
+#define TASK_RUNNING  1
+#define TASK_DONE     2
+
+struct task
+{
+  const char *name;
+  task_func func;
+  const void *arg;
+  uint64_t deps;    // bitmask of tasks that must complete first
+  int state;
+  pid_t pid;
+  int phase;        // timeline index
+};
+
+static struct task tasks[MAX_TASKS];
+static int num_tasks = 0;
+
+int task_add(const char *name, task_func func, const void *arg)
+{
+  if (num_tasks == MAX_TASKS) fatal("Too many setup tasks");
+
+  struct task *t = &tasks[num_tasks];
+  t->name  = name;
+  t->func  = func;
+  t->arg   = arg;
+  t->deps  = 0;
+  t->state = TASK_PENDING;
+  t->pid   = -1;
+  t->phase = -1;
+  return num_tasks++;
+}
+
+void task_dep(int task, int dep)
+{
+  if (task < 0 || task >= num_tasks || dep < 0 || dep >= num_tasks || dep == task) return;
+  tasks[task].deps |= 1ull << dep;
+}
+
+/*
+ * Return true if all dependencies of 't' are done.
+ */
+static int task_ready(struct task *t)
+{
+  int i;
+  for (i=0; i<num_tasks; i++)
+    if ((t->deps & (1ull << i)) && tasks[i].state != TASK_DONE) return 0;
+  return 1;
+}
+
+/*
+ * Fork a process to run task 't'.  If fork fails the task is
+ * run inline so setup still completes.
+ */
+static void task_start(struct task *t)
+{
+  debug("task_start '%s'", t->name);
+  t->phase = timeline_open(t->name);
+
+  pid_t pid = fork();
+  if (pid == 0)
+  {
+    t->func(t->arg);
+    _exit(0);
+  }
+
+  if (pid < 0)
+  {
+    warn("fork failed for task '%s': %s", t->name, strerror(errno));
+    t->func(t->arg);
+    timeline_close(t->phase);
+    t->state = TASK_DONE;
+    return;
+  }
+
+  t->pid   = pid;
+  t->state = TASK_RUNNING;
+}
+
+void task_run_all()
+{
+  for (;;)
+  {
+    // start every pending task whose dependencies are done
+    int i, started = 0, running = 0, pending = 0;
+    for (i=0; i<num_tasks; i++)
+    {
+      struct task *t = &tasks[i];
+      if (t->state == TASK_PENDING && task_ready(t)) { task_start(t); started++; }
+      if (t->state == TASK_RUNNING) running++;
+      if (t->state == TASK_PENDING) pending++;
+    }
+
+    if (running == 0)
+    {
+      if (pending == 0) break;
+
+      // a task that ran inline may have unblocked others
+      if (started == 0) fatal("Setup task dependency cycle");
+      continue;
+    }
+
+    // wait for next task to finish
+    int status;
+    pid_t pid = waitpid(-1, &status, 0);
+    if (pid < 0)
+    {
+      if (errno == EINTR) continue;
+      fatal("waitpid failed for setup tasks: %s", strerror(errno));
+    }
+
+    for (i=0; i<num_tasks; i++)
+    {
+      struct task *t = &tasks[i];
+      if (t->state != TASK_RUNNING || t->pid != pid) continue;
+      timeline_close(t->phase);
+      t->state = TASK_DONE;
+      debug("task_done '%s'", t->name);
+      if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        warn("Setup task '%s' failed", t->name);
+    }
+  }
+
+  num_tasks = 0;
+}
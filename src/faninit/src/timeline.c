@@ -0,0 +1,87 @@
+/*
+// Copyright (c) 2026, Andy Frank
+// Licensed under the Apache License version 2.0
+//
+// History:
+//   19 Oct 2026  Andy Frank  Creation
+*/
+
+#include "faninit.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define MAX_PHASES 48
+
+struct phase
+{
+  const char *name;
+  uint64_t start;   // usec since boot
+  uint64_t end;     // usec since boot or 0 if still open
+};
+
+static struct phase phases[MAX_PHASES];
+static int num_phases = 0;
+static int cur_phase = -1;  // open sequential phase or -1
+
+int timeline_open(const char *name)
+{
+  if (num_phases == MAX_PHASES) return -1;
+
+  struct phase *p = &phases[num_phases];
+  p->name  = name;
+  p->start = now_us();
+  p->end   = 0;
+  return num_phases++;
+}
+
+void timeline_close(int index)
+{
+  if (index < 0 || index >= num_phases) return;
+  struct phase *p = &phases[index];
+  if (p->end == 0) p->end = now_us();
+}
+
+void timeline_begin(const char *name)
+{
+  timeline_end();
+  cur_phase = timeline_open(name);
+}
+
+void timeline_end()
+{
+  timeline_close(cur_phase);
+  cur_phase = -1;
+}
+
+void timeline_write()
+{
+  int i;
+  for (i=0; i<num_phases; i++) timeline_close(i);
+
+  FILE *fp = fopen(BOOT_TIMELINE, "w");
+  if (fp == NULL) warn("Cannot write %s", BOOT_TIMELINE);
+
+  if (fp) fprintf(fp, "# phase start_us dur_us\n");
+
+  for (i=0; i<num_phases; i++)
+  {
+    struct phase *p = &phases[i];
+    uint64_t dur = p->end - p->start;
+    if (fp) fprintf(fp, "%s %llu %llu\n", p->name,
+      (unsigned long long)p->start, (unsigned long long)dur);
+
+    if (options.print_timing)
+      warn("timing: %-24s +%llu.%03llums", p->name,
+        (unsigned long long)(dur / 1000), (unsigned long long)(dur % 1000));
+  }
+
+  if (options.print_timing && num_phases > 0)
+  {
+    uint64_t total = phases[num_phases-1].end - phases[0].start;
+    warn("timing: %-24s +%llu.%03llums", "total",
+      (unsigned long long)(total / 1000), (unsigned long long)(total % 1000));
+  }
+
+  if (fp) fclose(fp);
+}
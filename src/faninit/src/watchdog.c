@@ -0,0 +1,201 @@
+/*
+// Copyright (c) 2026, Andy Frank
+// Licensed under the Apache License version 2.0
+//
+// History:
+//   19 Oct 2026  Andy Frank  Creation
+*/
+
+#include "faninit.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <linux/watchdog.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+// Interval faninit pings the device and checks heartbeats
+#define WATCHDOG_TICK_MS 1000
+
+// Minimum device timeout in seconds
+#define WATCHDOG_MIN_TIMEOUT 5
+
+static int enabled   = 0;
+static int dev_fd    = -1;    // /dev/watchdog or -1 if not available
+static int fifo_fd   = -1;    // heartbeat fifo or -1 if not yet created
+static int heartbeat = 30;    // sec allowed between JVM heartbeats; 0 to not require
+static int boot      = 120;   // sec allowed before first JVM heartbeat
+static const char *dump_path = NULL;
+static int stalled = 0;       // last JVM was killed for missing heartbeats
+
+void watchdog_open()
+{
+  // watchdog.timeout enables supervision
+  int timeout = get_prop_int(props, "watchdog.timeout", 0, 0, 86400);
+  if (timeout == 0) return;
+
+  enabled   = 1;
+  heartbeat = get_prop_int(props, "watchdog.heartbeat", heartbeat, 0, 86400);
+  boot      = get_prop_int(props, "watchdog.boot", boot, 0, 86400);
+  dump_path = get_prop(props, "watchdog.dump", NULL);
+
+  // heartbeats are still supervised in software if the board
+  // does not have a watchdog device
+  const char *dev = get_prop(props, "watchdog.device", WATCHDOG_DEVICE);
+  dev_fd = open(dev, O_WRONLY | O_CLOEXEC);
+  if (dev_fd < 0)
+  {
+    warn("Cannot open %s: %s", dev, strerror(errno));
+    return;
+  }
+
+  // leave room for the diagnostic dump and shutdown, which do
+  // not ping the device
+  if (timeout < WATCHDOG_MIN_TIMEOUT) timeout = WATCHDOG_MIN_TIMEOUT;
+  if (ioctl(dev_fd, WDIOC_SETTIMEOUT, &timeout) < 0)
+    warn("Cannot set %s timeout: %s", dev, strerror(errno));
+
+  debug("watchdog %s timeout=%ds heartbeat=%ds boot=%ds", dev, timeout, heartbeat, boot);
+}
+
+void watchdog_setup_fifo()
+{
+  if (!enabled) return;
+  if (mkfifo(WATCHDOG_FIFO, 0666) < 0 && errno != EEXIST)
+    warn("Cannot create %s: %s", WATCHDOG_FIFO, strerror(errno));
+}
+
+void watchdog_ping()
+{
+  if (dev_fd >= 0) ioctl(dev_fd, WDIOC_KEEPALIVE, 0);
+}
+
+void watchdog_disarm()
+{
+  if (dev_fd < 0) return;
+
+  // magic close stops the timer on drivers that allow it
+  OK_OR_WARN(write(dev_fd, "V", 1), "Cannot disarm watchdog");
+  close(dev_fd);
+  dev_fd = -1;
+}
+
+/*
+ * Copy 'path' to the console and 'fp' with each line prefixed
+ * by 'label'. Only lines starting with 'filter' are copied if
+ * not NULL.
+ */
+static void dump_file(FILE *fp, const char *label, const char *path, const char *filter)
+{
+  FILE *in = fopen(path, "r");
+  if (in == NULL) return;
+
+  char line[256];
+  while (fgets(line, sizeof(line), in) != NULL)
+  {
+    if (filter != NULL && strncmp(line, filter, strlen(filter)) != 0) continue;
+    line[strcspn(line, "\n")] = '\0';
+    warn("watchdog: %s: %s", label, line);
+    if (fp) fprintf(fp, "%s: %s\n", label, line);
+  }
+  fclose(in);
+}
+
+/*
+ * Log diagnostics for a stalled JVM before it is killed.
+ */
+static void dump_diagnostics(pid_t pid, uint64_t stalled_ms)
+{
+  warn("watchdog: no heartbeat from JVM in %llums", (unsigned long long)stalled_ms);
+
+  FILE *fp = NULL;
+  if (dump_path != NULL)
+  {
+    fp = fopen(dump_path, "a");
+    if (fp == NULL) warn("Cannot write %s: %s", dump_path, strerror(errno));
+  }
+  if (fp) fprintf(fp, "# stall pid=%d ms=%llu uptime_ms=%llu\n",
+                  (int)pid, (unsigned long long)stalled_ms, (unsigned long long)now_ms());
+
+  char path[FANINIT_PATH_MAX];
+  snprintf(path, sizeof(path), "/proc/%d/status", (int)pid);
+  dump_file(fp, "jvm", path, "State");
+  dump_file(fp, "jvm", path, "VmRSS");
+  dump_file(fp, "jvm", path, "Threads");
+  dump_file(fp, "loadavg", "/proc/loadavg", NULL);
+  dump_file(fp, "meminfo", "/proc/meminfo", "MemAvailable");
+  dump_file(fp, "pressure.cpu", "/proc/pressure/cpu", NULL);
+  dump_file(fp, "pressure.memory", "/proc/pressure/memory", NULL);
+
+  if (fp) fclose(fp);
+
+  // SIGQUIT makes the JVM print a thread dump to the console;
+  // give it a moment before the kill
+  watchdog_ping();
+  kill(pid, SIGQUIT);
+  sleep(2);
+}
+
+int watchdog_stalled()
+{
+  return stalled;
+}
+
+pid_t watchdog_wait(pid_t pid, int *status)
+{
+  stalled = 0;
+  if (!enabled) return waitpid(pid, status, 0);
+
+  uint64_t start = now_ms();
+  uint64_t last_beat = 0;   // 0 until first heartbeat
+  int killed = 0;
+
+  for (;;)
+  {
+    pid_t r = waitpid(pid, status, WNOHANG);
+    if (r != 0) return r;
+
+    // faninit is alive; keep the board up
+    watchdog_ping();
+
+    // fifo is created by the child once /run is mounted; open
+    // read/write so it never blocks or reports EOF when the JVM
+    // closes its end
+    if (fifo_fd < 0)
+      fifo_fd = open(WATCHDOG_FIFO, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+
+    struct pollfd pfd = { fifo_fd, POLLIN, 0 };
+    int n = poll(&pfd, fifo_fd < 0 ? 0 : 1, WATCHDOG_TICK_MS);
+    if (n < 0 && errno == EINTR) return -1;   // signal; same as waitpid
+
+    if (n > 0 && (pfd.revents & POLLIN))
+    {
+      char buf[64];
+      while (read(fifo_fd, buf, sizeof(buf)) > 0) {}
+      last_beat = now_ms();
+    }
+
+    if (heartbeat == 0 || killed) continue;
+
+    uint64_t now = now_ms();
+    uint64_t since = last_beat == 0 ? start : last_beat;
+    uint64_t limit = (uint64_t)(last_beat == 0 ? boot : heartbeat) * 1000;
+    if (now - since > limit)
+    {
+      // kill so the exit path runs as for any unexpected exit; the
+      // device is still pinged so a hung faninit resets the board
+      dump_diagnostics(pid, now - since);
+      kill(pid, SIGKILL);
+      killed = 1;
+      stalled = 1;
+    }
+  }
+}
@@ -13,36 +13,241 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <poll.h>
+#include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "../../common/src/log.h"
+#include "../../common/src/pack.h"
+
 #define KMSG_PATH "/dev/kmsg"
 #define BUFFER_SIZE 4096
 
-static void handle_kmsg(int fd)
+// records are batched until any limit is reached; bytes is kept
+// well under the 64K pack message limit
+#define BATCH_MS     50
+#define BATCH_RECS   64
+#define BATCH_BYTES  32768
+
+// minimum severity to forward (0=emerg .. 7=debug)
+static int min_priority = 7;
+
+struct batch
+{
+  struct pack_map *recs;      // pending records or NULL
+  int num;                    // number of pending records
+  int bytes;                  // approx encoded size of records
+  uint64_t deadline;          // ms when batch must be flushed
+  uint64_t dropped;           // records lost since last flush
+  long long last_seq;         // last sequence number read or -1
+};
+
+//////////////////////////////////////////////////////////////////////////
+// Parse
+//////////////////////////////////////////////////////////////////////////
+
+/*
+ * Unescape '\xNN' sequences in 's' in place.
+ */
+static void unescape(char *s)
+{
+  char *w = s;
+  while (*s)
+  {
+    unsigned int c;
+    if (s[0] == '\\' && s[1] == 'x' && sscanf(s + 2, "%2x", &c) == 1)
+    {
+      // replace control chars such as newlines with space
+      *w++ = c < 0x20 ? ' ' : c;
+      s += 4;
+    }
+    else *w++ = *s++;
+  }
+  *w = '\0';
+}
+
+/*
+ * Parse a kmsg record in 'buf' which must be null-terminated.
+ * Records are of the form:
+ *
+ *   priority,sequence,timestamp,flag[,...];message\n
+ *    KEY=value\n
+ *
+ * Returns a pack map or NULL if record could not be parsed or is
+ * filtered by 'min_priority'. The record sequence number is
+ * stored in 'seqp' if parsed, or -1 if not.
+ */
+static struct pack_map* parse_kmsg(char *buf, long long *seqp)
+{
+  *seqp = -1;
+  char *msg = strchr(buf, ';');
+  if (msg == NULL) return NULL;
+  *msg++ = '\0';
+
+  // prefix fields
+  int prio;
+  unsigned long long seq, ts;
+  char flag = '-';
+  if (sscanf(buf, "%d,%llu,%llu,%c", &prio, &seq, &ts, &flag) < 3) return NULL;
+  *seqp = seq;
+  if ((prio & 7) > min_priority) return NULL;
+
+  // message ends at newline; continuation lines follow
+  char *dict = strchr(msg, '\n');
+  if (dict != NULL) *dict++ = '\0';
+  unescape(msg);
+
+  struct pack_map *m = pack_map_new();
+  pack_set_int(m, "pri", prio & 7);
+  pack_set_int(m, "fac", prio >> 3);
+  pack_set_int(m, "seq", seq);
+  pack_set_int(m, "ts",  ts);
+  pack_set_str(m, "msg", msg);
+  if (flag == 'c') pack_set_bool(m, "cont", true);
+
+  // continuation lines are ' KEY=value' device properties
+  while (dict != NULL && dict[0] == ' ')
+  {
+    char *line = dict + 1;
+    dict = strchr(line, '\n');
+    if (dict != NULL) *dict++ = '\0';
+    if (strncmp(line, "SUBSYSTEM=", 10) == 0) pack_set_str(m, "subsystem", line + 10);
+    else if (strncmp(line, "DEVICE=", 7) == 0) pack_set_str(m, "device", line + 7);
+  }
+
+  return m;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Batch
+//////////////////////////////////////////////////////////////////////////
+
+/*
+ * Return monotonic time in milliseconds.
+ */
+static uint64_t now_ms()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*
+ * Return true if batch has records or drops to report.
+ */
+static bool batch_pending(struct batch *b)
+{
+  return b->num > 0 || b->dropped > 0;
+}
+
+/*
+ * Write pending records and dropped count to stdout as a single
+ * pack message, then reset batch.
+ */
+static void batch_flush(struct batch *b)
+{
+  if (!batch_pending(b)) return;
+
+  struct pack_map *m = pack_map_new();
+  pack_set_list(m, "recs", b->recs != NULL ? b->recs : pack_map_new());
+  if (b->dropped > 0) pack_set_int(m, "dropped", b->dropped);
+  if (pack_write(stdout, m) < 0) err(EXIT_FAILURE, "write stdout");
+  pack_map_free(m);
+
+  b->recs    = NULL;
+  b->num     = 0;
+  b->bytes   = 0;
+  b->dropped = 0;
+}
+
+/*
+ * Add record to batch, and flush if batch is full.
+ */
+static void batch_add(struct batch *b, struct pack_map *rec, int size)
+{
+  if (b->bytes + size > BATCH_BYTES) batch_flush(b);
+  if (!batch_pending(b)) b->deadline = now_ms() + BATCH_MS;
+  if (b->recs == NULL) b->recs = pack_map_new();
+
+  pack_list_add_map(b->recs, rec);
+  b->num++;
+  b->bytes += size;
+  if (b->num >= BATCH_RECS) batch_flush(b);
+}
+
+/*
+ * Account for any records skipped between last and 'seq'.
+ */
+static void batch_seq(struct batch *b, long long seq)
+{
+  if (seq < 0) return;
+  if (b->last_seq >= 0 && seq > b->last_seq + 1)
+  {
+    if (!batch_pending(b)) b->deadline = now_ms() + BATCH_MS;
+    b->dropped += seq - b->last_seq - 1;
+  }
+  b->last_seq = seq;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Main
+//////////////////////////////////////////////////////////////////////////
+
+/*
+ * Read all available records into batch. Each read returns
+ * exactly one record.
+ */
+static void handle_kmsg(int fd, struct batch *b)
 {
   char buffer[BUFFER_SIZE];
-  ssize_t amt = read(fd, buffer, sizeof(buffer));
-  if (amt < 0 && errno != EINTR)
-    err(EXIT_FAILURE, "read %s", KMSG_PATH);
-
-  while (amt > 0) {
-    ssize_t written = write(STDOUT_FILENO, buffer, amt);
-    if (written < 0 && errno != EINTR)
-      err(EXIT_FAILURE, "write stdout");
-    amt -= written;
+  for (;;)
+  {
+    ssize_t amt = read(fd, buffer, sizeof(buffer) - 1);
+    if (amt < 0)
+    {
+      if (errno == EINTR) continue;
+      if (errno == EAGAIN) return;
+
+      // EPIPE means records were overwritten before we read them;
+      // the next read resumes at the oldest record and the gap is
+      // counted from the sequence numbers
+      if (errno == EPIPE) continue;
+      err(EXIT_FAILURE, "read %s", KMSG_PATH);
+    }
+    if (amt == 0) return;
+    buffer[amt] = '\0';
+
+    long long seq;
+    struct pack_map *m = parse_kmsg(buffer, &seq);
+    batch_seq(b, seq);
+    if (m != NULL) batch_add(b, m, amt + 48);
   }
 }
 
 int main(int argc, char *argv[])
 {
-  (void) argc;
-  (void) argv;
+  // fankmsg [min_priority]
+  if (argc > 1)
+  {
+    char *end;
+    errno = 0;
+    long v = strtol(argv[1], &end, 10);
+    if (errno != 0 || end == argv[1] || *end != '\0' || v < 0 || v > 7)
+      errx(EXIT_FAILURE, "invalid priority '%s'", argv[1]);
+    min_priority = (int)v;
+  }
 
-  int fd = open(KMSG_PATH, O_RDONLY | O_CLOEXEC);
+  int fd = open(KMSG_PATH, O_RDONLY | O_CLOEXEC | O_NONBLOCK);
   if (fd < 0) err(EXIT_FAILURE, "open %s", KMSG_PATH);
 
+  struct batch b;
+  memset(&b, 0, sizeof(b));
+  b.last_seq = -1;
+
   for (;;)
   {
     struct pollfd fdset[2];
@@ -55,7 +260,15 @@ int main(int argc, char *argv[])
     fdset[1].events = POLLIN;
     fdset[1].revents = 0;
 
-    int rc = poll(fdset, 2, -1);
+    // wait for more records until pending batch is due
+    int timeout = -1;
+    if (batch_pending(&b))
+    {
+      uint64_t now = now_ms();
+      timeout = b.deadline > now ? (int)(b.deadline - now) : 0;
+    }
+
+    int rc = poll(fdset, 2, timeout);
     if (rc < 0)
     {
       // Retry if EINTR
@@ -64,11 +277,15 @@ int main(int argc, char *argv[])
       err(EXIT_FAILURE, "poll");
     }
 
-    if (fdset[0].revents & (POLLIN | POLLHUP)) handle_kmsg(fd);
+    if (fdset[0].revents & (POLLIN | POLLHUP)) handle_kmsg(fd, &b);
+
+    // flush once batch window has elapsed
+    if (batch_pending(&b) && now_ms() >= b.deadline) batch_flush(&b);
 
     // Any notification from Fantom is to exit
     if (fdset[1].revents & (POLLIN | POLLHUP)) break;
   }
 
+  batch_flush(&b);
   return 0;
 }
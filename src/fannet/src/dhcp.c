@@ -0,0 +1,689 @@
+/*
+// Copyright (c) 2026, Andy Frank
+// Licensed under the Apache License version 2.0
+//
+// History:
+//   19 Oct 2026  Andy Frank  Creation
+*/
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <poll.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <net/ethernet.h>
+#include <net/if.h>
+#include <netinet/ip.h>
+#include <netinet/udp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/filter.h>
+#include <linux/if_packet.h>
+
+#include "dhcp.h"
+#include "../../common/src/log.h"
+
+#define DHCP_SERVER_PORT 67
+#define DHCP_CLIENT_PORT 68
+#define DHCP_COOKIE      0x63825363
+
+// message types
+#define DHCPDISCOVER 1
+#define DHCPOFFER    2
+#define DHCPREQUEST  3
+#define DHCPACK      5
+#define DHCPNAK      6
+
+// options
+#define OPT_PAD          0
+#define OPT_SUBNET       1
+#define OPT_ROUTER       3
+#define OPT_DNS          6
+#define OPT_HOSTNAME     12
+#define OPT_DOMAIN       15
+#define OPT_REQ_ADDR     50
+#define OPT_LEASE        51
+#define OPT_MSG_TYPE     53
+#define OPT_SERVER_ID    54
+#define OPT_PARAM_REQ    55
+#define OPT_MAX_SIZE     57
+#define OPT_T1           58
+#define OPT_T2           59
+#define OPT_CLIENT_ID    61
+#define OPT_RAPID_COMMIT 80
+#define OPT_END          255
+
+// retransmit backoff in ms; first retry is short since a lost
+// DISCOVER on link-up directly delays boot
+#define DHCP_RETRY_MIN   2000
+#define DHCP_RETRY_MAX   32000
+#define DHCP_REQUEST_MAX 4
+#define DHCP_RENEW_MIN   60000
+
+enum dhcp_state {
+  DHCP_INIT = 0,
+  DHCP_SELECTING,
+  DHCP_REQUESTING,
+  DHCP_BOUND,
+  DHCP_RENEWING,
+  DHCP_REBINDING
+};
+
+struct dhcp_msg
+{
+  uint8_t op;
+  uint8_t htype;
+  uint8_t hlen;
+  uint8_t hops;
+  uint32_t xid;
+  uint16_t secs;
+  uint16_t flags;
+  uint32_t ciaddr;
+  uint32_t yiaddr;
+  uint32_t siaddr;
+  uint32_t giaddr;
+  uint8_t chaddr[16];
+  uint8_t sname[64];
+  uint8_t file[128];
+  uint32_t cookie;
+  uint8_t options[312];
+} __attribute__((packed));
+
+struct dhcp_packet
+{
+  struct iphdr ip;
+  struct udphdr udp;
+  struct dhcp_msg msg;
+} __attribute__((packed));
+
+struct dhcp_client
+{
+  enum dhcp_state state;
+  const char *ifname;
+  int ifindex;
+  uint8_t mac[6];
+  const char *hostname;
+  dhcp_callback cb;
+
+  int raw;                    // packet socket while unbound or -1
+  int udp;                    // udp socket while renewing or -1
+  uint32_t xid;
+  int tries;
+  uint64_t start;             // ms when acquisition started
+  uint64_t deadline;          // ms of next timeout
+  uint64_t bound_at;          // ms when lease was bound
+
+  struct in_addr offer;       // offered addr from DHCPOFFER
+  struct in_addr offer_server;
+  struct in_addr prev;        // last bound addr or INADDR_ANY
+  struct dhcp_lease lease;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// Utils
+//////////////////////////////////////////////////////////////////////////
+
+/*
+ * Return monotonic time in milliseconds.
+ */
+static uint64_t now_ms()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*
+ * Compute internet checksum over 'len' bytes.
+ */
+static uint16_t checksum(const void *data, int len)
+{
+  const uint16_t *p = data;
+  uint32_t sum = 0;
+  for (; len > 1; len -= 2) sum += *p++;
+  if (len == 1) sum += *(const uint8_t *)p;
+  while (sum >> 16) sum = (sum & 0xffff) + (sum >> 16);
+  return ~sum;
+}
+
+/*
+ * Return retransmit timeout for attempt 'tries' with +/- 1s
+ * of randomization per RFC 2131 4.1.
+ */
+static uint64_t retry_ms(int tries)
+{
+  uint64_t t = DHCP_RETRY_MIN;
+  while (tries-- > 0 && t < DHCP_RETRY_MAX) t *= 2;
+  if (t > DHCP_RETRY_MAX) t = DHCP_RETRY_MAX;
+  return t - 1000 + (random() % 2000);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Sockets
+//////////////////////////////////////////////////////////////////////////
+
+/*
+ * Open a packet socket on interface which only accepts UDP
+ * packets to the DHCP client port. Returns fd or -1 on error.
+ */
+static int raw_open(int ifindex)
+{
+  // ip proto == udp && !fragment && udp dport == 68
+  static struct sock_filter code[] = {
+    BPF_STMT(BPF_LD  | BPF_B   | BPF_ABS, 9),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,   IPPROTO_UDP, 0, 6),
+    BPF_STMT(BPF_LD  | BPF_H   | BPF_ABS, 6),
+    BPF_JUMP(BPF_JMP | BPF_JSET| BPF_K,   0x1fff, 4, 0),
+    BPF_STMT(BPF_LDX | BPF_B   | BPF_MSH, 0),
+    BPF_STMT(BPF_LD  | BPF_H   | BPF_IND, 2),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,   DHCP_CLIENT_PORT, 0, 1),
+    BPF_STMT(BPF_RET | BPF_K, 0xffffffff),
+    BPF_STMT(BPF_RET | BPF_K, 0),
+  };
+  struct sock_fprog prog = { .len = sizeof(code)/sizeof(code[0]), .filter = code };
+
+  int fd = socket(AF_PACKET, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, htons(ETH_P_IP));
+  if (fd < 0) return -1;
+
+  struct sockaddr_ll sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sll_family   = AF_PACKET;
+  sa.sll_protocol = htons(ETH_P_IP);
+  sa.sll_ifindex  = ifindex;
+  if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) < 0 ||
+      bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0)
+  {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/*
+ * Open a UDP socket on the DHCP client port bound to interface
+ * 'ifname'. Returns fd or -1 on error.
+ */
+static int udp_open(const char *ifname)
+{
+  int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, IPPROTO_UDP);
+  if (fd < 0) return -1;
+
+  int on = 1;
+  struct sockaddr_in sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_port   = htons(DHCP_CLIENT_PORT);
+  if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) < 0 ||
+      setsockopt(fd, SOL_SOCKET, SO_BROADCAST, &on, sizeof(on)) < 0 ||
+      setsockopt(fd, SOL_SOCKET, SO_BINDTODEVICE, ifname, strlen(ifname)) < 0 ||
+      bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0)
+  {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/*
+ * Close client sockets if open.
+ */
+static void sockets_close(struct dhcp_client *c)
+{
+  if (c->raw >= 0) { close(c->raw); c->raw = -1; }
+  if (c->udp >= 0) { close(c->udp); c->udp = -1; }
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Encode
+//////////////////////////////////////////////////////////////////////////
+
+/*
+ * Append option to 'opts' at offset 'off'. Returns new offset.
+ */
+static int opt_add(uint8_t *opts, int off, uint8_t code, const void *data, uint8_t len)
+{
+  // always leave room for OPT_END
+  if (off + 2 + len >= 311) return off;
+  opts[off++] = code;
+  opts[off++] = len;
+  if (len > 0) memcpy(&opts[off], data, len);
+  return off + len;
+}
+
+/*
+ * Build a DISCOVER or REQUEST message for current client state.
+ */
+static void msg_build(struct dhcp_client *c, struct dhcp_msg *m, uint8_t type)
+{
+  memset(m, 0, sizeof(*m));
+  m->op     = 1;
+  m->htype  = 1;
+  m->hlen   = 6;
+  m->xid    = c->xid;
+  m->secs   = htons((now_ms() - c->start) / 1000);
+  m->cookie = htonl(DHCP_COOKIE);
+  memcpy(m->chaddr, c->mac, 6);
+
+  // renewing and rebinding identify lease by ciaddr
+  bool has_addr = c->state == DHCP_RENEWING || c->state == DHCP_REBINDING;
+  if (has_addr) m->ciaddr = c->lease.addr.s_addr;
+  else m->flags = htons(0x8000);
+
+  uint8_t *o = m->options;
+  int off = 0;
+  off = opt_add(o, off, OPT_MSG_TYPE, &type, 1);
+
+  uint8_t cid[7] = { 1 };
+  memcpy(&cid[1], c->mac, 6);
+  off = opt_add(o, off, OPT_CLIENT_ID, cid, sizeof(cid));
+
+  uint16_t max = htons(576);
+  off = opt_add(o, off, OPT_MAX_SIZE, &max, 2);
+
+  if (type == DHCPDISCOVER)
+    off = opt_add(o, off, OPT_RAPID_COMMIT, NULL, 0);
+
+  if (type == DHCPREQUEST && c->state == DHCP_REQUESTING)
+  {
+    off = opt_add(o, off, OPT_REQ_ADDR,  &c->offer, 4);
+    off = opt_add(o, off, OPT_SERVER_ID, &c->offer_server, 4);
+  }
+
+  if (c->hostname != NULL)
+  {
+    size_t n = strlen(c->hostname);
+    off = opt_add(o, off, OPT_HOSTNAME, c->hostname, n > 255 ? 255 : n);
+  }
+
+  uint8_t params[] = { OPT_SUBNET, OPT_ROUTER, OPT_DNS, OPT_DOMAIN,
+                       OPT_LEASE, OPT_T1, OPT_T2 };
+  off = opt_add(o, off, OPT_PARAM_REQ, params, sizeof(params));
+  o[off] = OPT_END;
+}
+
+/*
+ * Broadcast message on packet socket. Returns 0 on success
+ * or -1 on error.
+ */
+static int raw_send(struct dhcp_client *c, struct dhcp_msg *m)
+{
+  struct dhcp_packet p;
+  memset(&p, 0, sizeof(p));
+  memcpy(&p.msg, m, sizeof(*m));
+
+  p.udp.source = htons(DHCP_CLIENT_PORT);
+  p.udp.dest   = htons(DHCP_SERVER_PORT);
+  p.udp.len    = htons(sizeof(p.udp) + sizeof(p.msg));
+
+  p.ip.version  = 4;
+  p.ip.ihl      = sizeof(p.ip) >> 2;
+  p.ip.tot_len  = htons(sizeof(p));
+  p.ip.ttl      = 64;
+  p.ip.protocol = IPPROTO_UDP;
+  p.ip.saddr    = INADDR_ANY;
+  p.ip.daddr    = INADDR_BROADCAST;
+  p.ip.check    = checksum(&p.ip, sizeof(p.ip));
+
+  struct sockaddr_ll sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sll_family   = AF_PACKET;
+  sa.sll_protocol = htons(ETH_P_IP);
+  sa.sll_ifindex  = c->ifindex;
+  sa.sll_halen    = 6;
+  memset(sa.sll_addr, 0xff, 6);
+
+  return sendto(c->raw, &p, sizeof(p), 0, (struct sockaddr *)&sa, sizeof(sa)) < 0 ? -1 : 0;
+}
+
+/*
+ * Send message on UDP socket to 'dst'. Returns 0 on success
+ * or -1 on error.
+ */
+static int udp_send(struct dhcp_client *c, struct dhcp_msg *m, struct in_addr dst)
+{
+  struct sockaddr_in sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_port   = htons(DHCP_SERVER_PORT);
+  sa.sin_addr   = dst;
+  return sendto(c->udp, m, sizeof(*m), 0, (struct sockaddr *)&sa, sizeof(sa)) < 0 ? -1 : 0;
+}
+
+/*
+ * Send DISCOVER or REQUEST for current state and schedule the
+ * next retransmit.
+ */
+static void send_msg(struct dhcp_client *c, uint8_t type)
+{
+  struct dhcp_msg m;
+  msg_build(c, &m, type);
+
+  int r;
+  if (c->state == DHCP_RENEWING)
+    r = udp_send(c, &m, c->lease.server);
+  else if (c->state == DHCP_REBINDING)
+  {
+    struct in_addr bcast = { .s_addr = INADDR_BROADCAST };
+    r = udp_send(c, &m, bcast);
+  }
+  else
+    r = raw_send(c, &m);
+
+  if (r < 0) log_debug("fannet: dhcp send failed: %s", strerror(errno));
+  c->deadline = now_ms() + retry_ms(c->tries++);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Decode
+//////////////////////////////////////////////////////////////////////////
+
+/*
+ * Parse options from message into 'lease'. Returns message type
+ * or -1 if message is invalid.
+ */
+static int msg_parse(struct dhcp_msg *m, int len, struct dhcp_lease *lease)
+{
+  int optlen = len - (int)offsetof(struct dhcp_msg, options);
+  if (optlen < 0 || ntohl(m->cookie) != DHCP_COOKIE) return -1;
+
+  memset(lease, 0, sizeof(*lease));
+  lease->addr.s_addr = m->yiaddr;
+
+  int type = -1;
+  uint8_t *o = m->options;
+  int i = 0;
+  while (i < optlen)
+  {
+    uint8_t code = o[i++];
+    if (code == OPT_PAD) continue;
+    if (code == OPT_END || i >= optlen) break;
+    uint8_t n = o[i++];
+    if (i + n > optlen) break;
+    uint8_t *v = &o[i];
+    i += n;
+
+    switch (code)
+    {
+      case OPT_MSG_TYPE:     if (n >= 1) type = v[0]; break;
+      case OPT_SUBNET:       if (n >= 4) memcpy(&lease->mask, v, 4); break;
+      case OPT_ROUTER:       if (n >= 4) memcpy(&lease->router, v, 4); break;
+      case OPT_SERVER_ID:    if (n >= 4) memcpy(&lease->server, v, 4); break;
+      case OPT_LEASE:        if (n >= 4) { memcpy(&lease->lease, v, 4); lease->lease = ntohl(lease->lease); } break;
+      case OPT_T1:           if (n >= 4) { memcpy(&lease->t1, v, 4); lease->t1 = ntohl(lease->t1); } break;
+      case OPT_T2:           if (n >= 4) { memcpy(&lease->t2, v, 4); lease->t2 = ntohl(lease->t2); } break;
+      case OPT_RAPID_COMMIT: lease->rapid_commit = true; break;
+      case OPT_DOMAIN:
+        memcpy(lease->domain, v, n);
+        lease->domain[n] = '\0';
+        break;
+      case OPT_DNS:
+        for (; lease->num_dns < DHCP_DNS_MAX && n >= 4; n -= 4, v += 4)
+          memcpy(&lease->dns[lease->num_dns++], v, 4);
+        break;
+    }
+  }
+  return type;
+}
+
+/*
+ * Read a message from the packet socket into 'm' and its IP source
+ * address into 'src'. Returns message length or -1 if no valid
+ * message was read.
+ */
+static int raw_recv(struct dhcp_client *c, struct dhcp_msg *m, struct in_addr *src)
+{
+  struct dhcp_packet p;
+  ssize_t n = recv(c->raw, &p, sizeof(p), 0);
+  if (n < (ssize_t)(sizeof(p.ip) + sizeof(p.udp))) return -1;
+
+  // filter matched udp dport 68; skip ip options if present
+  int ihl = p.ip.ihl * 4;
+  if (p.ip.version != 4 || ihl < (int)sizeof(p.ip) || n < ihl + (ssize_t)sizeof(p.udp)) return -1;
+  uint8_t *udp = (uint8_t *)&p + ihl;
+  int len = n - ihl - sizeof(p.udp);
+  if (len <= 0) return -1;
+  memcpy(m, udp + sizeof(p.udp), len);
+  src->s_addr = p.ip.saddr;
+  return len;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// State
+//////////////////////////////////////////////////////////////////////////
+
+/*
+ * Enter INIT and broadcast DISCOVER.
+ */
+static void enter_init(struct dhcp_client *c)
+{
+  sockets_close(c);
+  c->raw = raw_open(c->ifindex);
+  if (c->raw < 0) log_fatal("fannet: dhcp socket failed: %s", strerror(errno));
+
+  c->state = DHCP_SELECTING;
+  c->xid   = random();
+  c->tries = 0;
+  c->start = now_ms();
+  send_msg(c, DHCPDISCOVER);
+}
+
+/*
+ * Apply ACK lease and enter BOUND.
+ */
+static void enter_bound(struct dhcp_client *c, struct dhcp_lease *lease)
+{
+  bool renew = c->state == DHCP_RENEWING || c->state == DHCP_REBINDING;
+
+  // fill in defaults per RFC 2131 4.4.5
+  if (lease->lease == 0) lease->lease = 3600;
+  if (lease->t1 == 0 || lease->t1 >= lease->lease) lease->t1 = lease->lease / 2;
+  if (lease->t2 == 0 || lease->t2 >= lease->lease) lease->t2 = (uint64_t)lease->lease * 7 / 8;
+  if (lease->mask.s_addr == INADDR_ANY) lease->mask.s_addr = htonl(0xffffff00);
+  if (lease->server.s_addr == INADDR_ANY) lease->server = c->offer_server;
+
+  c->lease    = *lease;
+  c->state    = DHCP_BOUND;
+  c->bound_at = now_ms();
+  c->deadline = c->bound_at + (uint64_t)lease->t1 * 1000;
+  sockets_close(c);
+
+  c->cb(renew ? DHCP_EVENT_RENEW : DHCP_EVENT_BOUND, &c->lease, c->prev, c->bound_at - c->start);
+  c->prev = c->lease.addr;
+}
+
+/*
+ * Drop current lease and restart from INIT.
+ */
+static void enter_reset(struct dhcp_client *c, enum dhcp_event event)
+{
+  if (c->prev.s_addr != INADDR_ANY)
+  {
+    c->cb(event, &c->lease, c->prev, now_ms() - c->start);
+    c->prev.s_addr = INADDR_ANY;
+  }
+  memset(&c->lease, 0, sizeof(c->lease));
+  enter_init(c);
+}
+
+/*
+ * Handle retransmit or lease timer expiration.
+ */
+static void on_timeout(struct dhcp_client *c)
+{
+  uint64_t now = now_ms();
+  uint64_t t2  = c->bound_at + (uint64_t)c->lease.t2 * 1000;
+  uint64_t end = c->bound_at + (uint64_t)c->lease.lease * 1000;
+
+  switch (c->state)
+  {
+    case DHCP_INIT:
+      enter_init(c);
+      break;
+
+    case DHCP_SELECTING:
+      send_msg(c, DHCPDISCOVER);
+      break;
+
+    case DHCP_REQUESTING:
+      if (c->tries >= DHCP_REQUEST_MAX) enter_init(c);
+      else send_msg(c, DHCPREQUEST);
+      break;
+
+    case DHCP_BOUND:
+      if (now >= end) { enter_reset(c, DHCP_EVENT_EXPIRE); break; }
+      c->udp = udp_open(c->ifname);
+      if (c->udp < 0)
+      {
+        log_debug("fannet: dhcp udp socket failed: %s", strerror(errno));
+        c->deadline = now + retry_ms(0);
+        break;
+      }
+      c->state = DHCP_RENEWING;
+      c->xid   = random();
+      c->tries = 0;
+      c->start = now;
+      // fall through
+
+    case DHCP_RENEWING:
+    case DHCP_REBINDING:
+      if (now >= end) { enter_reset(c, DHCP_EVENT_EXPIRE); break; }
+      if (c->state == DHCP_RENEWING && now >= t2) c->state = DHCP_REBINDING;
+      send_msg(c, DHCPREQUEST);
+
+      // retransmit at half the remaining time to next state per
+      // RFC 2131 4.4.5, but no sooner than 60s
+      uint64_t next = c->state == DHCP_RENEWING ? t2 : end;
+      uint64_t wait = (next - now) / 2;
+      if (wait < DHCP_RENEW_MIN) wait = DHCP_RENEW_MIN;
+      c->deadline = now + wait < next ? now + wait : next;
+      break;
+  }
+}
+
+/*
+ * Handle an incoming server message sent from 'src'.
+ */
+static void on_msg(struct dhcp_client *c, struct dhcp_msg *m, int len, struct in_addr src)
+{
+  // ignore truncated messages before reading any header fields
+  if (len < (int)offsetof(struct dhcp_msg, options)) return;
+  if (m->op != 2 || m->xid != c->xid) return;
+  if (memcmp(m->chaddr, c->mac, 6) != 0) return;
+
+  struct dhcp_lease lease;
+  int type = msg_parse(m, len, &lease);
+
+  switch (c->state)
+  {
+    case DHCP_SELECTING:
+      if (type == DHCPACK && lease.rapid_commit)
+      {
+        // renewals are unicast to the server id, so fall back to
+        // the sender if missing and drop the ACK if neither is set
+        if (lease.server.s_addr == INADDR_ANY) lease.server = src;
+        if (lease.server.s_addr != INADDR_ANY) enter_bound(c, &lease);
+        break;
+      }
+      if (type != DHCPOFFER || lease.server.s_addr == INADDR_ANY) break;
+      c->offer        = lease.addr;
+      c->offer_server = lease.server;
+      c->state = DHCP_REQUESTING;
+      c->tries = 0;
+      send_msg(c, DHCPREQUEST);
+      break;
+
+    case DHCP_REQUESTING:
+    case DHCP_RENEWING:
+    case DHCP_REBINDING:
+      if (type == DHCPACK) enter_bound(c, &lease);
+      else if (type == DHCPNAK) enter_reset(c, DHCP_EVENT_NAK);
+      break;
+
+    default:
+      break;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Run
+//////////////////////////////////////////////////////////////////////////
+
+int dhcp_run(const char *ifname, const char *hostname, dhcp_callback cb)
+{
+  struct dhcp_client c;
+  memset(&c, 0, sizeof(c));
+  c.raw = -1;
+  c.udp = -1;
+  c.hostname = hostname;
+  c.cb = cb;
+  c.ifname = ifname;
+
+  // lookup ifindex and mac
+  c.ifindex = if_nametoindex(ifname);
+  if (c.ifindex == 0) return -1;
+  int h = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+  if (h < 0) return -1;
+  struct ifreq ifr;
+  memset(&ifr, 0, sizeof(ifr));
+  strncpy(ifr.ifr_name, ifname, sizeof(ifr.ifr_name) - 1);
+  int r = ioctl(h, SIOCGIFHWADDR, &ifr);
+  close(h);
+  if (r < 0) return -1;
+  memcpy(c.mac, ifr.ifr_hwaddr.sa_data, 6);
+
+  srandom(now_ms() ^ ((uint32_t)c.mac[2] << 24 | c.mac[3] << 16 | c.mac[4] << 8 | c.mac[5]));
+  enter_init(&c);
+
+  for (;;)
+  {
+    struct pollfd fdset[2];
+    int nfds = 1;
+
+    fdset[0].fd = STDIN_FILENO;
+    fdset[0].events = POLLIN;
+    fdset[0].revents = 0;
+
+    int fd = c.raw >= 0 ? c.raw : c.udp;
+    if (fd >= 0)
+    {
+      fdset[1].fd = fd;
+      fdset[1].events = POLLIN;
+      fdset[1].revents = 0;
+      nfds = 2;
+    }
+
+    uint64_t now = now_ms();
+    int timeout = c.deadline <= now ? 0 : (int)(c.deadline - now);
+    int rc = poll(fdset, nfds, timeout);
+    if (rc < 0)
+    {
+      // Retry if EINTR
+      if (errno == EINTR) continue;
+      log_fatal("poll");
+    }
+
+    if (rc == 0) { on_timeout(&c); continue; }
+
+    if (nfds == 2 && (fdset[1].revents & POLLIN))
+    {
+      struct dhcp_msg m;
+      struct sockaddr_in from;
+      socklen_t fromlen = sizeof(from);
+      memset(&from, 0, sizeof(from));
+      int len = c.raw >= 0
+        ? raw_recv(&c, &m, &from.sin_addr)
+        : recvfrom(c.udp, &m, sizeof(m), 0, (struct sockaddr *)&from, &fromlen);
+      if (len > 0) on_msg(&c, &m, len, from.sin_addr);
+    }
+
+    // Any notification from Fantom is to exit
+    if (fdset[0].revents & (POLLIN | POLLHUP)) break;
+  }
+
+  sockets_close(&c);
+  return 0;
+}
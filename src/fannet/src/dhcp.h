@@ -0,0 +1,57 @@
+/*
+// Copyright (c) 2026, Andy Frank
+// Licensed under the Apache License version 2.0
+//
+// History:
+//   19 Oct 2026  Andy Frank  Creation
+*/
+
+#ifndef DHCP_H
+#define DHCP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <netinet/in.h>
+
+#define DHCP_DNS_MAX 3
+
+enum dhcp_event {
+  DHCP_EVENT_BOUND = 0,   // new lease acquired
+  DHCP_EVENT_RENEW,       // existing lease extended
+  DHCP_EVENT_NAK,         // server rejected lease
+  DHCP_EVENT_EXPIRE       // lease expired without renewal
+};
+
+struct dhcp_lease
+{
+  struct in_addr addr;
+  struct in_addr mask;
+  struct in_addr router;          // INADDR_ANY if none
+  struct in_addr server;
+  struct in_addr dns[DHCP_DNS_MAX];
+  int num_dns;
+  char domain[256];
+  uint32_t lease;                 // lease time in seconds
+  uint32_t t1;                    // renew time in seconds
+  uint32_t t2;                    // rebind time in seconds
+  bool rapid_commit;              // bound via rapid commit
+};
+
+/*
+ * Callback invoked on lease changes. 'lease' is the current lease
+ * and 'prev' the previously bound address, or INADDR_ANY if none.
+ * 'elapsed' is milliseconds since the client started acquiring
+ * this lease.
+ */
+typedef void (*dhcp_callback)(enum dhcp_event event, const struct dhcp_lease *lease,
+                              struct in_addr prev, uint64_t elapsed);
+
+/*
+ * Run DHCPv4 client on interface 'ifname', invoking 'cb' on each
+ * lease event, until stdin is closed or any input is received.
+ * 'hostname' is sent to the server if not NULL. Returns 0 on
+ * exit or -1 if client could not be started.
+ */
+int dhcp_run(const char *ifname, const char *hostname, dhcp_callback cb);
+
+#endif
@@ -11,17 +11,24 @@
 #include <errno.h>
 // #include <fcntl.h>
 #include <poll.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
+#include <time.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
+#include <sys/timerfd.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <netinet/in.h>
 #include <net/if.h>
 #include <net/if_arp.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
 
+#include "dhcp.h"
 #include "../../common/src/log.h"
 #include "../../common/src/pack.h"
 
@@ -39,16 +46,16 @@
 // Helpers
 //////////////////////////////////////////////////////////////////////////
 
-// /*
-//  * Send an ok pack response to stdout.
-//  */
-// static void send_ok()
-// {
-//   struct pack_map *res = pack_map_new();
-//   pack_set_str(res, "status", "ok");
-//   if (pack_write(stdout, res) < 0) log_debug("fannet: send_ok failed");
-//   pack_map_free(res);
-// }
+/*
+ * Send an ok pack response to stdout.
+ */
+static void send_ok()
+{
+  struct pack_map *res = pack_map_new();
+  pack_set_str(res, "status", "ok");
+  if (pack_write(stdout, res) < 0) log_debug("fannet: send_ok failed");
+  pack_map_free(res);
+}
 
 /*
  * Send an error pack response to stdout.
@@ -62,6 +69,850 @@ static void send_err(char *msg)
   pack_map_free(res);
 }
 
+/*
+ * Send an error pack response for errno with given prefix.
+ */
+static void send_errno(char *prefix)
+{
+  char msg[256];
+  snprintf(msg, sizeof(msg), "%s: %s", prefix, strerror(errno));
+  send_err(msg);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Netlink
+//////////////////////////////////////////////////////////////////////////
+
+/*
+ * Open a NETLINK_ROUTE socket subscribed to given multicast
+ * 'groups', or 0 for request/response only. Returns fd or
+ * -1 on error.
+ */
+static int nl_open(uint32_t groups)
+{
+  int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+  if (fd < 0) return -1;
+
+  struct sockaddr_nl sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.nl_family = AF_NETLINK;
+  sa.nl_groups = groups;
+  if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0)
+  {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/*
+ * Send a dump request for given RTM_GETxxx 'type'.
+ */
+static int nl_dump(int fd, int type, uint32_t seq)
+{
+  struct { struct nlmsghdr nh; struct rtgenmsg g; } req;
+  memset(&req, 0, sizeof(req));
+  req.nh.nlmsg_len   = NLMSG_LENGTH(sizeof(struct rtgenmsg));
+  req.nh.nlmsg_type  = type;
+  req.nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+  req.nh.nlmsg_seq   = seq;
+  req.g.rtgen_family = AF_UNSPEC;
+  return send(fd, &req, req.nh.nlmsg_len, 0) < 0 ? -1 : 0;
+}
+
+/*
+ * Append an attribute to request 'nh' whose buffer is 'maxlen'
+ * bytes. Returns 0 on success or -1 if buffer is too small.
+ */
+static int nl_attr(struct nlmsghdr *nh, size_t maxlen, int type, const void *data, size_t len)
+{
+  size_t alen = RTA_LENGTH(len);
+  if (NLMSG_ALIGN(nh->nlmsg_len) + RTA_ALIGN(alen) > maxlen) return -1;
+
+  struct rtattr *rta = (struct rtattr *)((char *)nh + NLMSG_ALIGN(nh->nlmsg_len));
+  rta->rta_type = type;
+  rta->rta_len  = alen;
+  memcpy(RTA_DATA(rta), data, len);
+  nh->nlmsg_len = NLMSG_ALIGN(nh->nlmsg_len) + RTA_ALIGN(alen);
+  return 0;
+}
+
+/*
+ * Send request 'nh' on 'fd' and block until the kernel acks.
+ * Returns 0 on success or -1 with errno set on failure.
+ */
+static int nl_request(int fd, struct nlmsghdr *nh)
+{
+  static uint32_t seq = 0;
+  nh->nlmsg_flags |= NLM_F_REQUEST | NLM_F_ACK;
+  nh->nlmsg_seq = ++seq;
+  if (send(fd, nh, nh->nlmsg_len, 0) < 0) return -1;
+
+  char buf[4096];
+  for (;;)
+  {
+    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if (n < 0)
+    {
+      if (errno == EINTR) continue;
+      return -1;
+    }
+
+    int len = n;
+    struct nlmsghdr *r = (struct nlmsghdr *)buf;
+    for (; NLMSG_OK(r, len); r = NLMSG_NEXT(r, len))
+    {
+      if (r->nlmsg_seq != nh->nlmsg_seq) continue;
+      if (r->nlmsg_type != NLMSG_ERROR) continue;
+      struct nlmsgerr *e = NLMSG_DATA(r);
+      if (e->error == 0) return 0;
+      errno = -e->error;
+      return -1;
+    }
+  }
+}
+
+/*
+ * Format a MAC address into 'buf' which must be at least 18 bytes.
+ */
+static void fmt_mac(char *buf, size_t len, const uint8_t *m)
+{
+  snprintf(buf, len, "%02x:%02x:%02x:%02x:%02x:%02x", m[0], m[1], m[2], m[3], m[4], m[5]);
+}
+
+/*
+ * Encode an RTM_NEWLINK/RTM_DELLINK message into pack map using
+ * the same keys as the 'status' op.
+ */
+static struct pack_map* link_to_pack(struct nlmsghdr *nh)
+{
+  struct ifinfomsg *ifi = NLMSG_DATA(nh);
+  struct rtattr *rta = IFLA_RTA(ifi);
+  int len = IFLA_PAYLOAD(nh);
+  unsigned int flags = ifi->ifi_flags;
+
+  struct pack_map *m = pack_map_new();
+  pack_set_int(m,  "index",        ifi->ifi_index);
+  pack_set_str(m,  "type",         ifi->ifi_type == ARPHRD_ETHER ? "ethernet" : "other");
+  pack_set_bool(m, "up",           flags & IFF_UP);
+  pack_set_bool(m, "broadcast",    flags & IFF_BROADCAST);
+  pack_set_bool(m, "loopback",     flags & IFF_LOOPBACK);
+  pack_set_bool(m, "pointtopoint", flags & IFF_POINTOPOINT);
+  pack_set_bool(m, "running",      flags & IFF_RUNNING);
+  pack_set_bool(m, "multicast",    flags & IFF_MULTICAST);
+  pack_set_bool(m, "lowerup",      flags & WORKAROUND_IFF_LOWER_UP);
+
+  for (; RTA_OK(rta, len); rta = RTA_NEXT(rta, len))
+  {
+    switch (rta->rta_type)
+    {
+      case IFLA_IFNAME:
+        pack_set_str(m, "name", (char *)RTA_DATA(rta));
+        break;
+
+      case IFLA_MTU:
+        pack_set_int(m, "mtu", *(uint32_t *)RTA_DATA(rta));
+        break;
+
+      case IFLA_ADDRESS:
+        if (RTA_PAYLOAD(rta) == 6)
+        {
+          char mac[18];
+          fmt_mac(mac, sizeof(mac), RTA_DATA(rta));
+          pack_set_str(m, "mac", mac);
+        }
+        break;
+    }
+  }
+
+  return m;
+}
+
+/*
+ * Encode an RTM_NEWADDR/RTM_DELADDR message into pack map, or
+ * return NULL if not an IPv4 address.
+ */
+static struct pack_map* addr_to_pack(struct nlmsghdr *nh)
+{
+  struct ifaddrmsg *ifa = NLMSG_DATA(nh);
+  if (ifa->ifa_family != AF_INET) return NULL;
+
+  struct rtattr *rta = IFA_RTA(ifa);
+  int len = IFA_PAYLOAD(nh);
+  struct in_addr *local = NULL;
+  struct in_addr *addr = NULL;
+
+  for (; RTA_OK(rta, len); rta = RTA_NEXT(rta, len))
+  {
+    if (rta->rta_type == IFA_LOCAL)   local = RTA_DATA(rta);
+    if (rta->rta_type == IFA_ADDRESS) addr  = RTA_DATA(rta);
+  }
+
+  // IFA_LOCAL is the interface address for point-to-point links
+  if (local != NULL) addr = local;
+  if (addr == NULL) return NULL;
+
+  struct pack_map *m = pack_map_new();
+  pack_set_int(m, "index",  ifa->ifa_index);
+  pack_set_str(m, "ipaddr", inet_ntoa(*addr));
+  pack_set_int(m, "prefix", ifa->ifa_prefixlen);
+  return m;
+}
+
+/*
+ * Encode an RTM_NEWROUTE/RTM_DELROUTE message into pack map, or
+ * return NULL if not an IPv4 route in the main table.
+ */
+static struct pack_map* route_to_pack(struct nlmsghdr *nh)
+{
+  struct rtmsg *rt = NLMSG_DATA(nh);
+  if (rt->rtm_family != AF_INET) return NULL;
+  if (rt->rtm_table != RT_TABLE_MAIN) return NULL;
+
+  struct rtattr *rta = RTM_RTA(rt);
+  int len = RTM_PAYLOAD(nh);
+  struct in_addr dst = { .s_addr = INADDR_ANY };
+  struct in_addr *gw = NULL;
+  int oif = 0;
+
+  for (; RTA_OK(rta, len); rta = RTA_NEXT(rta, len))
+  {
+    switch (rta->rta_type)
+    {
+      case RTA_DST:     dst = *(struct in_addr *)RTA_DATA(rta); break;
+      case RTA_GATEWAY: gw  = RTA_DATA(rta); break;
+      case RTA_OIF:     oif = *(int *)RTA_DATA(rta); break;
+    }
+  }
+
+  struct pack_map *m = pack_map_new();
+  pack_set_int(m, "index",  oif);
+  pack_set_str(m, "dst",    inet_ntoa(dst));
+  pack_set_int(m, "prefix", rt->rtm_dst_len);
+  if (gw != NULL) pack_set_str(m, "gateway", inet_ntoa(*gw));
+  return m;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Stats
+//////////////////////////////////////////////////////////////////////////
+
+#define STATS_INTERVAL_MS 1000
+#define STATS_WINDOW      5
+#define STATS_MAX_LINKS   32
+
+// counter names in the order stored by 'link_stats'
+static char *stats_names[] = {
+  "rx_bytes",  "tx_bytes",  "rx_packets", "tx_packets",
+  "rx_errors", "tx_errors", "rx_dropped", "tx_dropped",
+};
+static char *stats_rate_names[] = {
+  "rx_bytes_rate",  "tx_bytes_rate",  "rx_packets_rate", "tx_packets_rate",
+  "rx_errors_rate", "tx_errors_rate", "rx_dropped_rate", "tx_dropped_rate",
+};
+#define STATS_NUM (sizeof(stats_names)/sizeof(stats_names[0]))
+
+/*
+ * Sample history for one interface, where the rolling rate is
+ * computed between the oldest and newest of the last
+ * STATS_WINDOW samples.
+ */
+struct stats_hist
+{
+  int index;          // ifindex or 0 if slot unused
+  bool seen;          // seen in current sample
+  int count;          // number of samples in ring
+  int head;           // ring index of next sample
+  uint64_t ms[STATS_WINDOW];
+  uint64_t vals[STATS_WINDOW][STATS_NUM];
+};
+
+static struct stats_hist stats_hist[STATS_MAX_LINKS];
+
+/*
+ * Read IFLA_STATS64 counters from an RTM_NEWLINK message into
+ * 'vals'. Returns false if message has no stats.
+ */
+static bool link_stats(struct nlmsghdr *nh, uint64_t *vals)
+{
+  struct ifinfomsg *ifi = NLMSG_DATA(nh);
+  struct rtattr *rta = IFLA_RTA(ifi);
+  int len = IFLA_PAYLOAD(nh);
+
+  for (; RTA_OK(rta, len); rta = RTA_NEXT(rta, len))
+  {
+    if (rta->rta_type != IFLA_STATS64) continue;
+
+    // attr may be unaligned or shorter on older kernels
+    struct rtnl_link_stats64 s;
+    size_t slen = RTA_PAYLOAD(rta);
+    memset(&s, 0, sizeof(s));
+    memcpy(&s, RTA_DATA(rta), slen < sizeof(s) ? slen : sizeof(s));
+
+    vals[0] = s.rx_bytes;
+    vals[1] = s.tx_bytes;
+    vals[2] = s.rx_packets;
+    vals[3] = s.tx_packets;
+    vals[4] = s.rx_errors;
+    vals[5] = s.tx_errors;
+    vals[6] = s.rx_dropped;
+    vals[7] = s.tx_dropped;
+    return true;
+  }
+  return false;
+}
+
+/*
+ * Add counters in 'vals' to pack map.
+ */
+static void stats_to_pack(struct pack_map *m, uint64_t *vals)
+{
+  unsigned int i;
+  for (i=0; i<STATS_NUM; i++) pack_set_int(m, stats_names[i], vals[i]);
+}
+
+/*
+ * Get current counters for interface 'index'. Returns 0 on
+ * success or -1 with errno set on failure.
+ */
+static int stats_get(int fd, int index, uint64_t *vals)
+{
+  struct { struct nlmsghdr nh; struct ifinfomsg ifi; } req;
+  memset(&req, 0, sizeof(req));
+  req.nh.nlmsg_len   = NLMSG_LENGTH(sizeof(struct ifinfomsg));
+  req.nh.nlmsg_type  = RTM_GETLINK;
+  req.nh.nlmsg_flags = NLM_F_REQUEST;
+  req.ifi.ifi_family = AF_UNSPEC;
+  req.ifi.ifi_index  = index;
+  if (send(fd, &req, req.nh.nlmsg_len, 0) < 0) return -1;
+
+  char buf[16384];
+  for (;;)
+  {
+    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if (n < 0)
+    {
+      if (errno == EINTR) continue;
+      return -1;
+    }
+
+    int len = n;
+    struct nlmsghdr *nh = (struct nlmsghdr *)buf;
+    for (; NLMSG_OK(nh, len); nh = NLMSG_NEXT(nh, len))
+    {
+      if (nh->nlmsg_type == NLMSG_ERROR)
+      {
+        struct nlmsgerr *e = NLMSG_DATA(nh);
+        errno = -e->error;
+        return -1;
+      }
+      if (nh->nlmsg_type != RTM_NEWLINK) continue;
+      if (link_stats(nh, vals)) return 0;
+      errno = ENODATA;
+      return -1;
+    }
+  }
+}
+
+/*
+ * Find or allocate history slot for interface 'index', or
+ * return NULL if all slots are in use.
+ */
+static struct stats_hist* stats_hist_get(int index)
+{
+  struct stats_hist *free_slot = NULL;
+  int i;
+  for (i=0; i<STATS_MAX_LINKS; i++)
+  {
+    struct stats_hist *h = &stats_hist[i];
+    if (h->index == index) return h;
+    if (h->index == 0 && free_slot == NULL) free_slot = h;
+  }
+  if (free_slot == NULL) return NULL;
+  memset(free_slot, 0, sizeof(*free_slot));
+  free_slot->index = index;
+  return free_slot;
+}
+
+/*
+ * Record a sample and return a pack map with current counters
+ * and per-second rates over the sample window.
+ */
+static struct pack_map* stats_hist_add(struct stats_hist *h, uint64_t now, uint64_t *vals)
+{
+  h->seen = true;
+  h->ms[h->head] = now;
+  memcpy(h->vals[h->head], vals, sizeof(h->vals[0]));
+  int newest = h->head;
+  h->head = (h->head + 1) % STATS_WINDOW;
+  if (h->count < STATS_WINDOW) h->count++;
+  int oldest = h->count < STATS_WINDOW ? 0 : h->head;
+
+  struct pack_map *m = pack_map_new();
+  pack_set_int(m, "index", h->index);
+  stats_to_pack(m, vals);
+
+  uint64_t dt = h->ms[newest] - h->ms[oldest];
+  unsigned int i;
+  for (i=0; i<STATS_NUM; i++)
+  {
+    // counters may reset if driver is reloaded
+    uint64_t a = h->vals[oldest][i];
+    uint64_t b = h->vals[newest][i];
+    int64_t rate = (dt == 0 || b < a) ? 0 : (int64_t)((b - a) * 1000 / dt);
+    pack_set_int(m, stats_rate_names[i], rate);
+  }
+  return m;
+}
+
+/*
+ * Sample counters for all interfaces and push a 'stats' event
+ * to stdout. Returns 0 on success or -1 on error.
+ */
+static int stats_sample(int fd)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  uint64_t now = (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+
+  int i;
+  for (i=0; i<STATS_MAX_LINKS; i++) stats_hist[i].seen = false;
+
+  if (nl_dump(fd, RTM_GETLINK, 0) < 0) return -1;
+
+  struct pack_map *links = pack_map_new();
+  char buf[16384];
+  bool done = false;
+  while (!done)
+  {
+    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if (n < 0)
+    {
+      if (errno == EINTR) continue;
+      pack_map_free(links);
+      return -1;
+    }
+
+    int len = n;
+    struct nlmsghdr *nh = (struct nlmsghdr *)buf;
+    for (; NLMSG_OK(nh, len); nh = NLMSG_NEXT(nh, len))
+    {
+      if (nh->nlmsg_type == NLMSG_DONE || nh->nlmsg_type == NLMSG_ERROR) { done = true; break; }
+      if (nh->nlmsg_type != RTM_NEWLINK) continue;
+
+      uint64_t vals[STATS_NUM];
+      struct ifinfomsg *ifi = NLMSG_DATA(nh);
+      struct stats_hist *h = stats_hist_get(ifi->ifi_index);
+      if (h == NULL || !link_stats(nh, vals)) continue;
+      pack_list_add_map(links, stats_hist_add(h, now, vals));
+    }
+  }
+
+  // release slots for removed interfaces
+  for (i=0; i<STATS_MAX_LINKS; i++)
+    if (!stats_hist[i].seen) stats_hist[i].index = 0;
+
+  struct pack_map *m = pack_map_new();
+  pack_set_str(m, "event", "stats");
+  pack_set_list(m, "links", links);
+  if (pack_write(stdout, m) < 0) log_debug("fannet: stats_sample write failed");
+  pack_map_free(m);
+  return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Monitor
+//////////////////////////////////////////////////////////////////////////
+
+/*
+ * Push a netlink change event to stdout.
+ */
+static void send_net_event(char *event, bool add, struct pack_map *m)
+{
+  pack_set_str(m, "event", event);
+  pack_set_str(m, "op",    add ? "new" : "del");
+  if (pack_write(stdout, m) < 0) log_debug("fannet: send_net_event failed");
+  pack_map_free(m);
+}
+
+/*
+ * Read and dispatch all pending netlink messages. Returns 1 if
+ * NLMSG_DONE was received for a dump, 0 if not, or -1 on error.
+ */
+static int on_netlink(int fd)
+{
+  char buf[16384];
+  ssize_t len = recv(fd, buf, sizeof(buf), 0);
+  if (len < 0) return errno == EINTR || errno == EAGAIN ? 0 : -1;
+
+  int done = 0;
+  struct nlmsghdr *nh = (struct nlmsghdr *)buf;
+  for (; NLMSG_OK(nh, len); nh = NLMSG_NEXT(nh, len))
+  {
+    struct pack_map *m;
+    switch (nh->nlmsg_type)
+    {
+      case NLMSG_DONE:
+      case NLMSG_ERROR:
+        done = 1;
+        break;
+
+      case RTM_NEWLINK:
+      case RTM_DELLINK:
+        send_net_event("link", nh->nlmsg_type == RTM_NEWLINK, link_to_pack(nh));
+        break;
+
+      case RTM_NEWADDR:
+      case RTM_DELADDR:
+        m = addr_to_pack(nh);
+        if (m != NULL) send_net_event("addr", nh->nlmsg_type == RTM_NEWADDR, m);
+        break;
+
+      case RTM_NEWROUTE:
+      case RTM_DELROUTE:
+        m = route_to_pack(nh);
+        if (m != NULL) send_net_event("route", nh->nlmsg_type == RTM_NEWROUTE, m);
+        break;
+    }
+  }
+  return done;
+}
+
+/*
+ * Push a state event with no fields to stdout.
+ */
+static void send_state_event(char *event)
+{
+  struct pack_map *m = pack_map_new();
+  pack_set_str(m, "event", event);
+  if (pack_write(stdout, m) < 0) log_debug("fannet: send_state_event failed");
+  pack_map_free(m);
+}
+
+/*
+ * Push current links, addresses, and routes as 'new' events,
+ * followed by a 'ready' event.
+ */
+static void monitor_dump(int fd)
+{
+  // each dump must complete before the next
+  int dumps[] = { RTM_GETLINK, RTM_GETADDR, RTM_GETROUTE };
+  unsigned int i;
+  for (i=0; i<sizeof(dumps)/sizeof(dumps[0]); i++)
+  {
+    if (nl_dump(fd, dumps[i], i+1) < 0) log_fatal("fannet: netlink dump failed");
+    int r;
+    while ((r = on_netlink(fd)) == 0) {}
+    if (r < 0) log_fatal("fannet: netlink recv failed: %s", strerror(errno));
+  }
+  send_state_event("ready");
+}
+
+/*
+ * Push current state using 'monitor_dump', then continue to
+ * push changes and a 'stats' event every STATS_INTERVAL_MS to
+ * stdout until stdin is closed or any input is received.
+ */
+static void monitor()
+{
+  int fd = nl_open(RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV4_ROUTE);
+  if (fd < 0) log_fatal("fannet: netlink socket failed: %s", strerror(errno));
+
+  // stats use a separate socket so dumps do not mix with events
+  int sfd = nl_open(0);
+  if (sfd < 0) log_fatal("fannet: netlink socket failed: %s", strerror(errno));
+
+  int tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  struct itimerspec its;
+  its.it_interval.tv_sec  = STATS_INTERVAL_MS / 1000;
+  its.it_interval.tv_nsec = (STATS_INTERVAL_MS % 1000) * 1000000;
+  its.it_value = its.it_interval;
+  if (tfd < 0 || timerfd_settime(tfd, 0, &its, NULL) < 0)
+    log_fatal("fannet: timerfd failed: %s", strerror(errno));
+
+  monitor_dump(fd);
+  stats_sample(sfd);
+
+  for (;;)
+  {
+    struct pollfd fdset[3];
+
+    fdset[0].fd = STDIN_FILENO;
+    fdset[0].events = POLLIN;
+    fdset[0].revents = 0;
+
+    fdset[1].fd = fd;
+    fdset[1].events = POLLIN;
+    fdset[1].revents = 0;
+
+    fdset[2].fd = tfd;
+    fdset[2].events = POLLIN;
+    fdset[2].revents = 0;
+
+    int rc = poll(fdset, 3, -1);
+    if (rc < 0)
+    {
+      // Retry if EINTR
+      if (errno == EINTR) continue;
+      log_fatal("poll");
+    }
+
+    if ((fdset[1].revents & POLLIN) && on_netlink(fd) < 0)
+    {
+      // ENOBUFS means events were dropped, so push full state again
+      int e = errno;
+      log_debug("fannet: netlink recv failed: %s", strerror(e));
+      if (e != ENOBUFS) break;
+      send_state_event("resync");
+      monitor_dump(fd);
+    }
+
+    if (fdset[2].revents & POLLIN)
+    {
+      uint64_t expired;
+      if (read(tfd, &expired, sizeof(expired)) > 0 && stats_sample(sfd) < 0)
+        log_debug("fannet: stats sample failed: %s", strerror(errno));
+    }
+
+    // Any notification from Fantom is to exit
+    if (fdset[0].revents & (POLLIN | POLLHUP)) break;
+  }
+
+  close(tfd);
+  close(sfd);
+  close(fd);
+  log_debug("fannet: bye-bye");
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Config
+//////////////////////////////////////////////////////////////////////////
+
+/*
+ * Set interface 'index' administratively up or down. Returns 0
+ * on success or -1 with errno set on failure.
+ */
+static int link_set_up(int fd, int index, bool up)
+{
+  struct { struct nlmsghdr nh; struct ifinfomsg ifi; } req;
+  memset(&req, 0, sizeof(req));
+  req.nh.nlmsg_len    = NLMSG_LENGTH(sizeof(struct ifinfomsg));
+  req.nh.nlmsg_type   = RTM_NEWLINK;
+  req.ifi.ifi_family  = AF_UNSPEC;
+  req.ifi.ifi_index   = index;
+  req.ifi.ifi_change  = IFF_UP;
+  req.ifi.ifi_flags   = up ? IFF_UP : 0;
+  return nl_request(fd, &req.nh);
+}
+
+/*
+ * Add or remove an IPv4 address on interface 'index'. Returns 0
+ * on success or -1 with errno set on failure.
+ */
+static int addr_set(int fd, int index, bool add, struct in_addr addr, int prefix)
+{
+  struct { struct nlmsghdr nh; struct ifaddrmsg ifa; char attrs[64]; } req;
+  memset(&req, 0, sizeof(req));
+  req.nh.nlmsg_len     = NLMSG_LENGTH(sizeof(struct ifaddrmsg));
+  req.nh.nlmsg_type    = add ? RTM_NEWADDR : RTM_DELADDR;
+  req.nh.nlmsg_flags   = add ? NLM_F_CREATE | NLM_F_REPLACE : 0;
+  req.ifa.ifa_family    = AF_INET;
+  req.ifa.ifa_prefixlen = prefix;
+  req.ifa.ifa_index     = index;
+  req.ifa.ifa_scope     = RT_SCOPE_UNIVERSE;
+
+  nl_attr(&req.nh, sizeof(req), IFA_LOCAL,   &addr, sizeof(addr));
+  nl_attr(&req.nh, sizeof(req), IFA_ADDRESS, &addr, sizeof(addr));
+  if (add && prefix < 31)
+  {
+    // match 'ip addr add ... brd +'
+    struct in_addr brd;
+    uint32_t mask = prefix == 0 ? 0 : htonl(0xffffffff << (32 - prefix));
+    brd.s_addr = addr.s_addr | ~mask;
+    nl_attr(&req.nh, sizeof(req), IFA_BROADCAST, &brd, sizeof(brd));
+  }
+  return nl_request(fd, &req.nh);
+}
+
+/*
+ * Remove all IPv4 addresses from interface 'index'. Returns 0 on
+ * success or -1 with errno set on failure.
+ */
+static int addr_flush(int fd, int index)
+{
+  // collect addrs first since we cannot issue requests mid-dump
+  struct { struct in_addr addr; int prefix; } addrs[32];
+  int num = 0;
+  bool done = false;
+
+  if (nl_dump(fd, RTM_GETADDR, 0) < 0) return -1;
+  char buf[16384];
+  while (!done)
+  {
+    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if (n < 0)
+    {
+      if (errno == EINTR) continue;
+      return -1;
+    }
+
+    int len = n;
+    struct nlmsghdr *nh = (struct nlmsghdr *)buf;
+    for (; NLMSG_OK(nh, len); nh = NLMSG_NEXT(nh, len))
+    {
+      if (nh->nlmsg_type == NLMSG_DONE || nh->nlmsg_type == NLMSG_ERROR) { done = true; break; }
+      if (nh->nlmsg_type != RTM_NEWADDR) continue;
+
+      struct ifaddrmsg *ifa = NLMSG_DATA(nh);
+      if (ifa->ifa_family != AF_INET || (int)ifa->ifa_index != index) continue;
+      if (num == sizeof(addrs)/sizeof(addrs[0])) continue;
+
+      struct rtattr *rta = IFA_RTA(ifa);
+      int alen = IFA_PAYLOAD(nh);
+      for (; RTA_OK(rta, alen); rta = RTA_NEXT(rta, alen))
+      {
+        if (rta->rta_type != IFA_LOCAL) continue;
+        addrs[num].addr   = *(struct in_addr *)RTA_DATA(rta);
+        addrs[num].prefix = ifa->ifa_prefixlen;
+        num++;
+      }
+    }
+  }
+
+  int i;
+  for (i=0; i<num; i++)
+  {
+    // deleting a primary addr may implicitly remove secondaries
+    if (addr_set(fd, index, false, addrs[i].addr, addrs[i].prefix) < 0 && errno != EADDRNOTAVAIL)
+      return -1;
+  }
+  return 0;
+}
+
+/*
+ * Add the IPv4 default route via 'gateway' on interface 'index'.
+ * Fails with EEXIST if a default route already exists, as with
+ * 'ip route add', unless 'replace' is true. Returns 0 on success
+ * or -1 with errno set on failure.
+ */
+static int route_set_default(int fd, int index, struct in_addr gateway, bool replace)
+{
+  struct { struct nlmsghdr nh; struct rtmsg rt; char attrs[64]; } req;
+  memset(&req, 0, sizeof(req));
+  req.nh.nlmsg_len    = NLMSG_LENGTH(sizeof(struct rtmsg));
+  req.nh.nlmsg_type   = RTM_NEWROUTE;
+  req.nh.nlmsg_flags  = NLM_F_CREATE | (replace ? NLM_F_REPLACE : NLM_F_EXCL);
+  req.rt.rtm_family   = AF_INET;
+  req.rt.rtm_table    = RT_TABLE_MAIN;
+  req.rt.rtm_protocol = RTPROT_BOOT;
+  req.rt.rtm_scope    = RT_SCOPE_UNIVERSE;
+  req.rt.rtm_type     = RTN_UNICAST;
+
+  nl_attr(&req.nh, sizeof(req), RTA_GATEWAY, &gateway, sizeof(gateway));
+  nl_attr(&req.nh, sizeof(req), RTA_OIF,     &index,   sizeof(index));
+  return nl_request(fd, &req.nh);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// DHCP
+//////////////////////////////////////////////////////////////////////////
+
+#define RESOLV_CONF "/tmp/resolv.conf"
+
+static int dhcp_ifindex;
+
+/*
+ * Write lease DNS servers to RESOLV_CONF. Returns 0 on success
+ * or -1 on error.
+ */
+static int dhcp_write_resolv(const struct dhcp_lease *lease)
+{
+  FILE *f = fopen(RESOLV_CONF, "w");
+  if (f == NULL) return -1;
+  if (lease->domain[0] != '\0') fprintf(f, "search %s\n", lease->domain);
+  int i;
+  for (i=0; i<lease->num_dns; i++) fprintf(f, "nameserver %s\n", inet_ntoa(lease->dns[i]));
+  return fclose(f);
+}
+
+/*
+ * Apply lease to interface. Returns NULL on success or an error
+ * message on failure with errno set.
+ */
+static char* dhcp_apply(enum dhcp_event event, const struct dhcp_lease *lease, struct in_addr prev)
+{
+  int fd = nl_open(0);
+  if (fd < 0) return "netlink socket failed";
+
+  char *msg = NULL;
+  bool bound = event == DHCP_EVENT_BOUND || event == DHCP_EVENT_RENEW;
+  int prefix = __builtin_popcount(lease->mask.s_addr);
+
+  // drop previous addr if lease was lost or addr changed
+  if (prev.s_addr != INADDR_ANY && (!bound || prev.s_addr != lease->addr.s_addr))
+    if (addr_flush(fd, dhcp_ifindex) < 0) msg = "addr flush failed";
+
+  if (bound && msg == NULL)
+  {
+    if (addr_set(fd, dhcp_ifindex, true, lease->addr, prefix) < 0)
+      msg = "addr add failed";
+    else if (lease->router.s_addr != INADDR_ANY && route_set_default(fd, dhcp_ifindex, lease->router, true) < 0)
+      msg = "route add failed";
+    else if (dhcp_write_resolv(lease) < 0)
+      msg = "write " RESOLV_CONF " failed";
+  }
+
+  // keep errno of the failed step for the caller to log
+  int e = errno;
+  close(fd);
+  errno = e;
+  return msg;
+}
+
+/*
+ * Callback from dhcp_run to apply lease and push event to stdout.
+ */
+static void on_dhcp(enum dhcp_event event, const struct dhcp_lease *lease,
+                    struct in_addr prev, uint64_t elapsed)
+{
+  static char *names[] = { "bound", "renew", "nak", "expire" };
+  char *err = dhcp_apply(event, lease, prev);
+  if (err != NULL) log_debug("fannet: dhcp %s: %s", err, strerror(errno));
+
+  struct pack_map *m = pack_map_new();
+  pack_set_str(m, "event", names[event]);
+  if (event == DHCP_EVENT_BOUND || event == DHCP_EVENT_RENEW)
+  {
+    // build space separated dns list
+    char dns[DHCP_DNS_MAX * 16] = "";
+    int i;
+    for (i=0; i<lease->num_dns; i++)
+    {
+      if (i > 0) strcat(dns, " ");
+      strcat(dns, inet_ntoa(lease->dns[i]));
+    }
+
+    pack_set_str(m, "ipaddr",  inet_ntoa(lease->addr));
+    pack_set_int(m, "prefix",  __builtin_popcount(lease->mask.s_addr));
+    pack_set_str(m, "netmask", inet_ntoa(lease->mask));
+    pack_set_str(m, "server",  inet_ntoa(lease->server));
+    pack_set_str(m, "dns",     dns);
+    pack_set_int(m, "lease",   lease->lease);
+    pack_set_int(m, "elapsed", elapsed);
+    pack_set_bool(m, "rapid_commit", lease->rapid_commit);
+    if (lease->router.s_addr != INADDR_ANY) pack_set_str(m, "router", inet_ntoa(lease->router));
+    if (lease->domain[0] != '\0') pack_set_str(m, "domain", (char *)lease->domain);
+  }
+  else
+  {
+    pack_set_str(m, "ipaddr", inet_ntoa(prev));
+  }
+  if (err != NULL) pack_set_str(m, "err", err);
+
+  if (pack_write(stdout, m) < 0) log_debug("fannet: on_dhcp write failed");
+  pack_map_free(m);
+}
+
 //////////////////////////////////////////////////////////////////////////
 // Pack
 //////////////////////////////////////////////////////////////////////////
@@ -142,9 +993,13 @@ static void on_status(struct pack_map *req)
   pack_set_str(res, "type", s.ifr_hwaddr.sa_family == ARPHRD_ETHER ? "ethernet" : "other");
   pack_set_str(res, "mac",  mac_str);
 
-  // TODO
-  // pack_set_int(res,  "index",        s.ifr_ifindex);
-  // pack_set_int(res,  "mtu",          s.ifr_mtu);
+  // index
+  if (ioctl(h, SIOCGIFINDEX, &s) == -1) { send_err("ioctl index failed"); goto STATUS_CLEANUP; }
+  pack_set_int(res, "index", s.ifr_ifindex);
+
+  // mtu
+  if (ioctl(h, SIOCGIFMTU, &s) == -1) { send_err("ioctl mtu failed"); goto STATUS_CLEANUP; }
+  pack_set_int(res, "mtu", s.ifr_mtu);
 
   // write resp
   if (pack_write(stdout, res) < 0) log_debug("fannet: on_status write failed");
@@ -154,6 +1009,127 @@ STATUS_CLEANUP:
   pack_map_free(res);
 }
 
+/*
+ * Resolve 'name' in request to an interface index, or send an
+ * error response and return 0 if not found.
+ */
+static int req_index(struct pack_map *req)
+{
+  char *name = pack_get_str(req, "name");
+  if (name == NULL) { send_err("missing 'name'"); return 0; }
+
+  int index = if_nametoindex(name);
+  if (index == 0) send_errno(name);
+  return index;
+}
+
+/*
+ * Return traffic counters for an interface.
+ */
+static void on_stats(struct pack_map *req)
+{
+  // debug
+  char *d = pack_debug(req);
+  log_debug("fannet: on_stats %s", d);
+  free(d);
+
+  int index = req_index(req);
+  if (index == 0) return;
+
+  int fd = nl_open(0);
+  if (fd < 0) { send_errno("netlink socket failed"); return; }
+
+  uint64_t vals[STATS_NUM];
+  if (stats_get(fd, index, vals) < 0) send_errno("stats failed");
+  else
+  {
+    struct pack_map *res = pack_map_new();
+    pack_set_str(res, "status", "ok");
+    pack_set_int(res, "index", index);
+    stats_to_pack(res, vals);
+    if (pack_write(stdout, res) < 0) log_debug("fannet: on_stats write failed");
+    pack_map_free(res);
+  }
+  close(fd);
+}
+
+/*
+ * Set an interface up or down.
+ */
+static void on_link_set(struct pack_map *req)
+{
+  // debug
+  char *d = pack_debug(req);
+  log_debug("fannet: on_link_set %s", d);
+  free(d);
+
+  int index = req_index(req);
+  if (index == 0) return;
+
+  int fd = nl_open(0);
+  if (fd < 0) { send_errno("netlink socket failed"); return; }
+
+  bool up = pack_get_bool(req, "up");
+  if (link_set_up(fd, index, up) < 0) send_errno("link set failed");
+  else send_ok();
+  close(fd);
+}
+
+/*
+ * Replace or add an IPv4 address on an interface, and optionally
+ * set the default route.
+ */
+static void on_addr_set(struct pack_map *req)
+{
+  // debug
+  char *d = pack_debug(req);
+  log_debug("fannet: on_addr_set %s", d);
+  free(d);
+
+  int index = req_index(req);
+  if (index == 0) return;
+
+  // check args before touching interface
+  char *ip = pack_get_str(req, "ip");
+  char *router = pack_get_str(req, "router");
+  int prefix = pack_get_int(req, "prefix");
+  struct in_addr addr, gw;
+  if (ip != NULL && inet_aton(ip, &addr) == 0) { send_err("invalid 'ip'"); return; }
+  if (router != NULL && inet_aton(router, &gw) == 0) { send_err("invalid 'router'"); return; }
+  if (ip != NULL && !pack_has(req, "prefix")) { send_err("missing 'prefix'"); return; }
+  if (prefix < 0 || prefix > 32) { send_err("invalid 'prefix'"); return; }
+
+  int fd = nl_open(0);
+  if (fd < 0) { send_errno("netlink socket failed"); return; }
+
+  if (pack_get_bool(req, "flush") && addr_flush(fd, index) < 0)
+    send_errno("addr flush failed");
+  else if (ip != NULL && addr_set(fd, index, true, addr, prefix) < 0)
+    send_errno("addr add failed");
+  else if (router != NULL && route_set_default(fd, index, gw, false) < 0)
+    send_errno("route add failed");
+  else
+    send_ok();
+
+  close(fd);
+}
+
+/*
+ * Set the system hostname.
+ */
+static void on_hostname(struct pack_map *req)
+{
+  // debug
+  char *d = pack_debug(req);
+  log_debug("fannet: on_hostname %s", d);
+  free(d);
+
+  char *name = pack_get_str(req, "hostname");
+  if (name == NULL) { send_err("missing 'hostname'"); return; }
+  if (sethostname(name, strlen(name)) < 0) send_errno("sethostname failed");
+  else send_ok();
+}
+
 /*
  * Callback to process an incoming Fantom request.
  * Returns -1 if process should exit, or 0 to continue.
@@ -164,6 +1140,10 @@ static int on_proc_req(struct pack_map *req)
 
   if (strcmp(op, "status") == 0) { on_status(req); return 0; }
   if (strcmp(op, "list")   == 0) { on_list(req);   return 0; }
+  if (strcmp(op, "stats")    == 0) { on_stats(req);    return 0; }
+  if (strcmp(op, "link_set") == 0) { on_link_set(req); return 0; }
+  if (strcmp(op, "addr_set") == 0) { on_addr_set(req); return 0; }
+  if (strcmp(op, "hostname") == 0) { on_hostname(req); return 0; }
   if (strcmp(op, "exit")   == 0) { return -1; }
 
   log_debug("fannet: unknown op '%s'", op);
@@ -176,6 +1156,21 @@ static int on_proc_req(struct pack_map *req)
 
 int main(int argc, char *argv[])
 {
+  if (argc == 2 && strcmp(argv[1], "monitor") == 0)
+  {
+    monitor();
+    return 0;
+  }
+
+  if ((argc == 3 || argc == 4) && strcmp(argv[1], "dhcp") == 0)
+  {
+    dhcp_ifindex = if_nametoindex(argv[2]);
+    if (dhcp_ifindex == 0) log_fatal("fannet: unknown interface '%s'", argv[2]);
+    if (dhcp_run(argv[2], argc == 4 ? argv[3] : NULL, on_dhcp) < 0)
+      log_fatal("fannet: dhcp failed: %s", strerror(errno));
+    return 0;
+  }
+
   struct pack_buf *buf = pack_buf_new();
 
   for (;;)
@@ -9,16 +9,21 @@
 // https://github.com/fhunleth/elixir_ale
 */
 
-#include <err.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <poll.h>
+#include <sched.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/timerfd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 
 #ifndef _IOC_SIZE_BITS
@@ -31,13 +36,56 @@
 #include "../../common/src/log.h"
 #include "../../common/src/pack.h"
 
-// Max SPI transfer size that we support
-#define SPI_TRANSFER_MAX 256
+// Max SPI transfer size that we support; the actual limit is
+// the smaller of this and the spidev 'bufsiz' module param.
+// Bounded by the 16-bit Pack buffer length.
+#define SPI_TRANSFER_MAX 60000
+
+// Default spidev 'bufsiz' if module param cannot be read
+#define SPI_BUFSIZ_DEFAULT 4096
+
+// Max number of segments in a single SPI_IOC_MESSAGE
+#define SPI_SEGS_MAX 64
+
+// Number of blocks buffered in stream ring buffer
+#define SPI_STREAM_RING_BLOCKS 16
+
+// Min stream sample period in nanoseconds
+#define SPI_STREAM_MIN_PERIOD 10000
+
+struct spi_stream
+{
+  bool active;
+  int tfd;                      // timerfd for sample period
+  int prio;                     // SCHED_FIFO priority or 0
+  int saved_policy;             // policy to restore if prio > 0
+  struct sched_param saved_param;
+  struct spi_ioc_transfer tfers[SPI_SEGS_MAX];
+  unsigned int n;               // number of segments in template
+  unsigned int total;           // total bytes per message
+  uint8_t *tx;                  // copy of template tx data
+  uint8_t *rx;                  // rx scratch for one message
+  uint16_t sample_size;         // rx bytes kept per sample
+  uint16_t block;               // samples per delivered block
+  uint8_t *ring;                // ring buffer of samples
+  unsigned int cap;             // ring capacity in samples
+  unsigned int head;            // next sample to read
+  unsigned int count;           // samples in ring
+  int64_t missed;               // overruns + dropped since last block
+  uint8_t *out;                 // encoded block being written or NULL
+  unsigned int out_len;         // bytes in out
+  unsigned int out_off;         // bytes of out already written
+};
 
 struct spi_info
 {
   int fd;
+  const char *devpath;
+  uint8_t mode;
   struct spi_ioc_transfer transfer;
+  unsigned int max_len;
+  struct spi_stream stream;
+  char last_err[128];
 };
 
 //////////////////////////////////////////////////////////////////////////
@@ -80,12 +128,97 @@ static void send_err(char *msg)
   pack_map_free(res);
 }
 
+/*
+ * Send an error pack response for 'errno' to stdout.
+ */
+static void send_errno(char *prefix)
+{
+  char msg[128];
+  snprintf(msg, sizeof(msg), "%s: %s", prefix, strerror(errno));
+  send_err(msg);
+}
+
 //////////////////////////////////////////////////////////////////////////
 // SPI
 //////////////////////////////////////////////////////////////////////////
 
+/*
+ * Read the max bytes spidev allows for a single message from
+ * the 'bufsiz' module param, capped to SPI_TRANSFER_MAX.
+ */
+static unsigned int spi_max_len()
+{
+  unsigned int bufsiz = SPI_BUFSIZ_DEFAULT;
+  FILE *f = fopen("/sys/module/spidev/parameters/bufsiz", "r");
+  if (f != NULL)
+  {
+    if (fscanf(f, "%u", &bufsiz) != 1) bufsiz = SPI_BUFSIZ_DEFAULT;
+    fclose(f);
+  }
+  return bufsiz > SPI_TRANSFER_MAX ? SPI_TRANSFER_MAX : bufsiz;
+}
+
+/*
+ * Open and configure device file. Returns 0 on success, or -1
+ * on failure with the reason stored in 'spi->last_err'.
+ */
+static int spi_open(struct spi_info *spi)
+{
+  uint8_t bits_per_word = spi->transfer.bits_per_word;
+  uint32_t speed_hz = spi->transfer.speed_hz;
+  char *op;
+
+  spi->fd = open(spi->devpath, O_RDWR | O_CLOEXEC);
+  if (spi->fd < 0) { op = "open"; goto fail; }
+
+  if (ioctl(spi->fd, SPI_IOC_WR_MODE, &spi->mode) < 0)
+    { op = "ioctl(SPI_IOC_WR_MODE)"; goto fail; }
+
+  // Set these to check for bad values given by the user. They get
+  // set again on each transfer.
+  if (ioctl(spi->fd, SPI_IOC_WR_BITS_PER_WORD, &bits_per_word) < 0)
+    { op = "ioctl(SPI_IOC_WR_BITS_PER_WORD)"; goto fail; }
+
+  if (ioctl(spi->fd, SPI_IOC_WR_MAX_SPEED_HZ, &speed_hz) < 0)
+    { op = "ioctl(SPI_IOC_WR_MAX_SPEED_HZ)"; goto fail; }
+
+  return 0;
+
+fail:
+  snprintf(spi->last_err, sizeof(spi->last_err), "%s %s: %s", op, spi->devpath, strerror(errno));
+  log_debug("fanspi: %s", spi->last_err);
+  if (spi->fd >= 0) close(spi->fd);
+  spi->fd = -1;
+  return -1;
+}
+
+/*
+ * Close and reopen device file after a transient error.
+ * Preserves errno of the original failure if reopen fails.
+ */
+static int spi_reopen(struct spi_info *spi)
+{
+  int e = errno;
+  log_debug("fanspi: reopen %s after error: %s", spi->devpath, strerror(e));
+  if (spi->fd >= 0) close(spi->fd);
+  if (spi_open(spi) < 0) { errno = e; return -1; }
+  return 0;
+}
+
+/*
+ * Return true if errno may succeed if retried on a new fd. Every
+ * SPI transfer clocks out tx data, so only errors raised before
+ * anything is sent are retried; a bus error may have already
+ * delivered a non-idempotent command to the device.
+ */
+static bool is_transient(int e)
+{
+  return e == EBADF || e == ENODEV;
+}
+
 /**
- * @brief  Initialize a SPI device
+ * @brief  Initialize a SPI device. Errors are not fatal and
+ *         are reported by the 'status' op.
  *
  * @param  spi            Handle to initialize
  * @param  devpath        Path to SPI device file
@@ -94,37 +227,26 @@ static void send_err(char *msg)
  * @param  speed_hz       Bus speed
  * @param  delay_usecs    Delay between transfers
  *
- * @retur  1 if success, -1 if fails
+ * @return  0 if success, -1 if fails
  */
-static void spi_init(struct spi_info *spi,
-                     const char *devpath,
-                     uint8_t mode,
-                     uint8_t bits_per_word,
-                     uint32_t speed_hz,
-                     uint16_t delay_usecs)
+static int spi_init(struct spi_info *spi,
+                    const char *devpath,
+                    uint8_t mode,
+                    uint8_t bits_per_word,
+                    uint32_t speed_hz,
+                    uint16_t delay_usecs)
 {
   memset(spi, 0, sizeof(*spi));
 
+  spi->devpath = devpath;
+  spi->mode = mode;
   spi->transfer.speed_hz = speed_hz;
   spi->transfer.delay_usecs = delay_usecs;
   spi->transfer.bits_per_word = bits_per_word;
+  spi->max_len = spi_max_len();
+  spi->stream.tfd = -1;
 
-  // Fail hard on error. May need to be nicer if this makes the
-  // Erlang side too hard to debug.
-  spi->fd = open(devpath, O_RDWR);
-  if (spi->fd < 0)
-    err(EXIT_FAILURE, "open %s", devpath);
-
-  if (ioctl(spi->fd, SPI_IOC_WR_MODE, &mode) < 0)
-    err(EXIT_FAILURE, "ioctl(SPI_IOC_WR_MODE %d)", mode);
-
-  // Set these to check for bad values given by the user. They get
-  // set again on each transfer.
-  if (ioctl(spi->fd, SPI_IOC_WR_BITS_PER_WORD, &bits_per_word) < 0)
-    err(EXIT_FAILURE, "ioctl(SPI_IOC_WR_BITS_PER_WORD %d)", bits_per_word);
-
-  if (ioctl(spi->fd, SPI_IOC_WR_MAX_SPEED_HZ, &speed_hz) < 0)
-    err(EXIT_FAILURE, "ioctl(SPI_IOC_WR_MAX_SPEED_HZ %d)", speed_hz);
+  return spi_open(spi);
 }
 
 /**
@@ -149,10 +271,30 @@ static int spi_transfer(struct spi_info *spi, const char *tx, char *rx, unsigned
 #pragma GCC diagnostic pop
   tfer.len = len;
 
-  if (ioctl(spi->fd, SPI_IOC_MESSAGE(1), &tfer) < 1)
-    err(EXIT_FAILURE, "ioctl(SPI_IOC_MESSAGE)");
+  if (ioctl(spi->fd, SPI_IOC_MESSAGE(1), &tfer) >= 1) return 1;
 
-  return 1;
+  // retry once on a fresh fd
+  if (!is_transient(errno) || spi_reopen(spi) < 0) return 0;
+  return ioctl(spi->fd, SPI_IOC_MESSAGE(1), &tfer) < 1 ? 0 : 1;
+}
+
+/**
+ * @brief spi transfer of multiple segments in a single message,
+ *        where chip select is held between segments unless
+ *        'cs_change' is set on a segment
+ *
+ * @param  tfers  Segments to transfer
+ * @param  n      Number of segments
+ *
+ * @return  1 for success, 0 for failure
+ */
+static int spi_transfer_segs(struct spi_info *spi, struct spi_ioc_transfer *tfers, unsigned int n)
+{
+  if (ioctl(spi->fd, SPI_IOC_MESSAGE(n), tfers) >= 0) return 1;
+
+  // retry once on a fresh fd
+  if (!is_transient(errno) || spi_reopen(spi) < 0) return 0;
+  return ioctl(spi->fd, SPI_IOC_MESSAGE(n), tfers) < 0 ? 0 : 1;
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -169,6 +311,8 @@ static void on_status(struct spi_info *spi, struct pack_map *req)
   log_debug("fanspi: on_status %s", d);
   free(d);
 
+  // report open failure, retrying in case device appeared
+  if (spi->fd < 0 && spi_open(spi) < 0) { send_err(spi->last_err); return; }
   send_ok();
 }
 
@@ -186,19 +330,391 @@ static void on_transfer(struct spi_info *spi, struct pack_map *req)
   uint8_t *data = pack_get_buf(req, "data");
 
   // check inputs
-  if (len <= 1 || len > SPI_TRANSFER_MAX) { send_err("missing or invalid 'len' field"); return; }
-  if (data == NULL) { send_err("missing or invalid 'data' field"); return; }
+  if (len < 1 || len > spi->max_len) { send_err("missing or invalid 'len' field"); return; }
+  if (data == NULL || pack_get_buf_len(req, "data") != len)
+  {
+    send_err("missing or invalid 'data' field");
+    return;
+  }
 
   // transfer
-  char rx[SPI_TRANSFER_MAX];
+  char *rx = malloc(len);
   if (spi_transfer(spi, (char*)data, rx, len))
   {
     send_ok_data((uint8_t*)rx, len);
   }
   else
   {
-    send_err("transfer failed");
+    send_errno("transfer failed");
   }
+  free(rx);
+}
+
+/*
+ * Validate a list of segments from request. Returns NULL if
+ * valid and stores total length in 'total', or returns error
+ * message if invalid.
+ */
+static char* check_segs(struct spi_info *spi, struct pack_map *segs, unsigned int *total)
+{
+  if (segs == NULL || segs->size < 1 || segs->size > SPI_SEGS_MAX)
+    return "missing or invalid 'segs' field";
+
+  struct pack_entry *e;
+  *total = 0;
+  for (e = segs->head; e != NULL; e = e->next)
+  {
+    if (e->type != PACK_TYPE_MAP) return "invalid segment";
+    int64_t len = pack_get_int(e->val.m, "len");
+    if (len < 1 || len > spi->max_len) return "invalid segment 'len' field";
+    if (pack_has(e->val.m, "tx") &&
+        (pack_get_buf(e->val.m, "tx") == NULL || pack_get_buf_len(e->val.m, "tx") != len))
+      return "invalid segment 'tx' field";
+    *total += len;
+  }
+
+  if (*total > spi->max_len) return "total segment length exceeds bufsiz";
+  return NULL;
+}
+
+/*
+ * Initialize transfers from a list of validated segments, where
+ * rx data for each segment is read into a single 'rx' block.
+ * Segment tx buffers point into the request map.
+ */
+static void init_segs(struct spi_info *spi, struct pack_map *segs,
+                      struct spi_ioc_transfer *tfers, uint8_t *rx)
+{
+  struct pack_entry *e;
+  unsigned int i = 0;
+  unsigned int off = 0;
+
+  memset(tfers, 0, sizeof(struct spi_ioc_transfer) * segs->size);
+  for (e = segs->head; e != NULL; e = e->next, i++)
+  {
+    struct pack_map *seg = e->val.m;
+    struct spi_ioc_transfer *t = &tfers[i];
+    uint8_t *tx = pack_get_buf(seg, "tx");
+
+    t->len = pack_get_int(seg, "len");
+    t->speed_hz = pack_has(seg, "speed") ? pack_get_int(seg, "speed") : spi->transfer.speed_hz;
+    t->bits_per_word = pack_has(seg, "bits") ? pack_get_int(seg, "bits") : spi->transfer.bits_per_word;
+    t->delay_usecs = pack_has(seg, "delay") ? pack_get_int(seg, "delay") : spi->transfer.delay_usecs;
+    t->cs_change = pack_get_bool(seg, "cs_change") ? 1 : 0;
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpointer-to-int-cast"
+    // a NULL tx_buf sends zeros; a NULL rx_buf discards rx
+    t->tx_buf = (__u64) tx;
+    t->rx_buf = pack_get_bool(seg, "rx") ? (__u64) &rx[off] : 0;
+#pragma GCC diagnostic pop
+    off += t->len;
+  }
+}
+
+/*
+ * Peform a list of SPI transfer segments in one message.
+ */
+static void on_transfer_segs(struct spi_info *spi, struct pack_map *req)
+{
+  // debug
+  char *d = pack_debug(req);
+  log_debug("fanspi: on_transfer_segs %s", d);
+  free(d);
+
+  // check inputs
+  struct pack_map *segs = pack_get_list(req, "segs");
+  unsigned int total;
+  char *msg = check_segs(spi, segs, &total);
+  if (msg != NULL) { send_err(msg); return; }
+
+  // build transfers; rx data is read into a single block
+  unsigned int n = segs->size;
+  struct spi_ioc_transfer tfers[SPI_SEGS_MAX];
+  uint8_t *rx = malloc(total);
+  init_segs(spi, segs, tfers, rx);
+
+  if (!spi_transfer_segs(spi, tfers, n))
+  {
+    send_errno("transfer failed");
+    free(rx);
+    return;
+  }
+
+  // response contains rx data per segment, which is empty
+  // for segments that did not request rx
+  struct pack_map *res  = pack_map_new();
+  struct pack_map *list = pack_map_new();
+  unsigned int i, off = 0;
+  for (i=0; i<n; i++)
+  {
+    uint16_t len = tfers[i].rx_buf == 0 ? 0 : tfers[i].len;
+    pack_list_add_buf(list, &rx[off], len);
+    off += tfers[i].len;
+  }
+  pack_set_str(res,  "status", "ok");
+  pack_set_list(res, "rx", list);
+  if (pack_write(stdout, res) < 0) log_debug("fanspi: send_ok failed");
+  pack_map_free(res);
+  free(rx);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Stream
+//////////////////////////////////////////////////////////////////////////
+
+/*
+ * Encode the next block of up to 'max' samples from the stream
+ * ring buffer into 'st->out' to be written to stdout.
+ */
+static void stream_encode_block(struct spi_stream *st, unsigned int max)
+{
+  unsigned int count = st->count < max ? st->count : max;
+  uint16_t len = count * st->sample_size;
+  uint8_t *data = malloc(len > 0 ? len : 1);
+  unsigned int i;
+
+  for (i=0; i<count; i++)
+  {
+    unsigned int slot = (st->head + i) % st->cap;
+    memcpy(&data[i * st->sample_size], &st->ring[slot * st->sample_size], st->sample_size);
+  }
+  st->head = (st->head + count) % st->cap;
+  st->count -= count;
+
+  struct pack_map *res = pack_map_new();
+  pack_set_str(res, "event",  "samples");
+  pack_set_int(res, "count",  count);
+  pack_set_int(res, "missed", st->missed);
+  pack_set_buf(res, "data",   data, len);
+  st->out = pack_encode(res);
+  st->out_len = ((st->out[2] << 8) | st->out[3]) + 4;
+  st->out_off = 0;
+  pack_map_free(res);
+  free(data);
+  st->missed = 0;
+}
+
+/*
+ * Write the next chunk of the pending block to stdout. Chunks
+ * are at most PIPE_BUF bytes, which a pipe that poll reports as
+ * writable accepts without blocking, so a slow reader does not
+ * stall the sample loop.
+ */
+static void stream_write_out(struct spi_stream *st)
+{
+  unsigned int n = st->out_len - st->out_off;
+  if (n > PIPE_BUF) n = PIPE_BUF;
+
+  ssize_t w = write(STDOUT_FILENO, &st->out[st->out_off], n);
+  if (w < 0)
+  {
+    if (errno == EINTR || errno == EAGAIN) return;
+    log_debug("fanspi: stream write failed: %s", strerror(errno));
+    w = st->out_len - st->out_off;
+  }
+
+  st->out_off += w;
+  if (st->out_off < st->out_len) return;
+  free(st->out);
+  st->out = NULL;
+  st->out_len = 0;
+  st->out_off = 0;
+}
+
+/*
+ * Block until the pending block has been written to stdout,
+ * which must happen before any other response is sent.
+ */
+static void stream_flush_out(struct spi_stream *st)
+{
+  while (st->out != NULL) stream_write_out(st);
+}
+
+/*
+ * Timer callback to perform one sample transfer and append
+ * the rx bytes to the ring buffer.
+ */
+static void stream_sample(struct spi_info *spi)
+{
+  struct spi_stream *st = &spi->stream;
+
+  // check for missed periods
+  uint64_t exp;
+  if (read(st->tfd, &exp, sizeof(exp)) != sizeof(exp)) return;
+  if (exp > 1) st->missed += exp - 1;
+
+  if (!spi_transfer_segs(spi, st->tfers, st->n))
+  {
+    log_debug("fanspi: stream transfer failed: %s", strerror(errno));
+    st->missed++;
+    return;
+  }
+
+  // drop oldest sample if ring is full
+  if (st->count == st->cap)
+  {
+    st->head = (st->head + 1) % st->cap;
+    st->count--;
+    st->missed++;
+  }
+
+  // copy rx segments into ring slot
+  unsigned int slot = (st->head + st->count) % st->cap;
+  uint8_t *p = &st->ring[slot * st->sample_size];
+  unsigned int i, off = 0;
+  for (i=0; i<st->n; i++)
+  {
+    if (st->tfers[i].rx_buf != 0)
+    {
+      memcpy(p, &st->rx[off], st->tfers[i].len);
+      p += st->tfers[i].len;
+    }
+    off += st->tfers[i].len;
+  }
+  st->count++;
+}
+
+/*
+ * Stop stream and free resources. Does not flush ring.
+ */
+static void stream_free(struct spi_stream *st)
+{
+  if (st->tfd >= 0) close(st->tfd);
+  if (st->prio > 0)
+  {
+    // restore the policy the helper was started with
+    if (sched_setscheduler(0, st->saved_policy, &st->saved_param) < 0)
+      log_debug("fanspi: restore sched failed: %s", strerror(errno));
+    munlockall();
+  }
+  free(st->out);
+  free(st->tx);
+  free(st->rx);
+  free(st->ring);
+  memset(st, 0, sizeof(*st));
+  st->tfd = -1;
+}
+
+/*
+ * Start streaming sample transfers on a timer.
+ */
+static void on_stream_start(struct spi_info *spi, struct pack_map *req)
+{
+  // debug
+  char *d = pack_debug(req);
+  log_debug("fanspi: on_stream_start %s", d);
+  free(d);
+
+  struct spi_stream *st = &spi->stream;
+  if (st->active) { send_err("stream already started"); return; }
+
+  // check inputs
+  struct pack_map *segs = pack_get_list(req, "segs");
+  unsigned int total;
+  char *msg = check_segs(spi, segs, &total);
+  if (msg != NULL) { send_err(msg); return; }
+
+  int64_t period = pack_get_int(req, "period");
+  int64_t block  = pack_get_int(req, "block");
+  int64_t prio   = pack_get_int(req, "prio");
+  if (period < SPI_STREAM_MIN_PERIOD) { send_err("missing or invalid 'period' field"); return; }
+  if (block < 1) { send_err("missing or invalid 'block' field"); return; }
+  if (prio < 0 || prio > sched_get_priority_max(SCHED_FIFO)) { send_err("invalid 'prio' field"); return; }
+
+  // sample size is total rx bytes per message
+  struct pack_entry *e;
+  unsigned int sample_size = 0;
+  for (e = segs->head; e != NULL; e = e->next)
+    if (pack_get_bool(e->val.m, "rx")) sample_size += pack_get_int(e->val.m, "len");
+  if (sample_size < 1) { send_err("no rx segments"); return; }
+  if (sample_size * block > SPI_TRANSFER_MAX) { send_err("block size too large"); return; }
+
+  // build template; copy tx data since req is freed after return
+  st->n = segs->size;
+  st->total = total;
+  st->sample_size = sample_size;
+  st->block = block;
+  st->rx = malloc(total);
+  st->tx = malloc(total);
+  init_segs(spi, segs, st->tfers, st->rx);
+  unsigned int i, off = 0;
+  for (i=0; i<st->n; i++)
+  {
+    if (st->tfers[i].tx_buf != 0)
+    {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wint-to-pointer-cast"
+#pragma GCC diagnostic ignored "-Wpointer-to-int-cast"
+      memcpy(&st->tx[off], (void *)(uintptr_t)st->tfers[i].tx_buf, st->tfers[i].len);
+      st->tfers[i].tx_buf = (__u64) &st->tx[off];
+#pragma GCC diagnostic pop
+    }
+    off += st->tfers[i].len;
+  }
+
+  st->cap  = block * SPI_STREAM_RING_BLOCKS;
+  st->ring = malloc(st->cap * sample_size);
+
+  // optional realtime priority for the sample loop
+  if (prio > 0)
+  {
+    st->saved_policy = sched_getscheduler(0);
+    sched_getparam(0, &st->saved_param);
+
+    struct sched_param sp = { .sched_priority = prio };
+    if (sched_setscheduler(0, SCHED_FIFO, &sp) < 0)
+    {
+      log_debug("fanspi: sched_setscheduler failed: %s", strerror(errno));
+      stream_free(st);
+      send_err("failed to set realtime priority");
+      return;
+    }
+    st->prio = prio;
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) < 0)
+      log_debug("fanspi: mlockall failed: %s", strerror(errno));
+  }
+
+  // start timer
+  st->tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  struct itimerspec its;
+  its.it_interval.tv_sec  = period / 1000000000;
+  its.it_interval.tv_nsec = period % 1000000000;
+  its.it_value = its.it_interval;
+  if (st->tfd < 0 || timerfd_settime(st->tfd, 0, &its, NULL) < 0)
+  {
+    log_debug("fanspi: timerfd failed: %s", strerror(errno));
+    stream_free(st);
+    send_err("failed to start timer");
+    return;
+  }
+
+  st->active = true;
+  send_ok();
+}
+
+/*
+ * Stop streaming, flush remaining samples, and ack.
+ */
+static void on_stream_stop(struct spi_info *spi, struct pack_map *req)
+{
+  // debug
+  char *d = pack_debug(req);
+  log_debug("fanspi: on_stream_stop %s", d);
+  free(d);
+
+  struct spi_stream *st = &spi->stream;
+  if (st->active)
+  {
+    stream_flush_out(st);
+    while (st->count > 0)
+    {
+      stream_encode_block(st, st->block);
+      stream_flush_out(st);
+    }
+    stream_free(st);
+  }
+  send_ok();
 }
 
 /*
@@ -209,7 +725,23 @@ static int on_proc_req(struct spi_info *spi, struct pack_map *req)
 {
   char *op = pack_get_str(req, "op");
 
+  // device must be open for all other ops
+  if (spi->fd < 0 && strcmp(op, "status") != 0 && strcmp(op, "exit") != 0)
+  {
+    if (spi_open(spi) < 0) { send_err(spi->last_err); return 0; }
+  }
+
+  // only stream ops are allowed while streaming
+  if (spi->stream.active && strcmp(op, "stream_stop") != 0 && strcmp(op, "exit") != 0)
+  {
+    send_err("stream active");
+    return 0;
+  }
+
   if (strcmp(op, "transfer") == 0) { on_transfer(spi, req); return 0; }
+  if (strcmp(op, "transfer_segs") == 0) { on_transfer_segs(spi, req); return 0; }
+  if (strcmp(op, "stream_start")  == 0) { on_stream_start(spi, req); return 0; }
+  if (strcmp(op, "stream_stop")   == 0) { on_stream_stop(spi, req); return 0; }
   if (strcmp(op, "status")   == 0) { on_status(spi, req); return 0; }
   if (strcmp(op, "exit")     == 0) { return -1; }
 
@@ -232,21 +764,34 @@ int main(int argc, char *argv[])
   uint32_t speed = (uint32_t) strtoul(argv[4], 0, 0);
   uint16_t delay = (uint16_t) strtoul(argv[5], 0, 0);
 
+  // open failures are reported on first request
   struct spi_info spi;
   spi_init(&spi, devpath, mode, bits, speed, delay);
 
   struct pack_buf *buf = pack_buf_new();
-  log_debug("fanspi: open %s mode=%d bits=%d speed=%d delay=%d", devpath, mode, bits, speed, delay);
+  log_debug("fanspi: open %s mode=%d bits=%d speed=%d delay=%d max_len=%u",
+    devpath, mode, bits, speed, delay, spi.max_len);
 
   for (;;)
   {
-    struct pollfd fdset[1];
+    struct spi_stream *st = &spi.stream;
+    struct pollfd fdset[3];
     fdset[0].fd = STDIN_FILENO;
     fdset[0].events = POLLIN;
     fdset[0].revents = 0;
 
-    // wait for stdin message
-    int rc = poll(fdset, 1, -1);
+    // stream timer; ignored by poll if not streaming
+    fdset[1].fd = st->active ? st->tfd : -1;
+    fdset[1].events = POLLIN;
+    fdset[1].revents = 0;
+
+    // only wait on stdout when a block is pending or a full block is ready
+    fdset[2].fd = st->active && (st->out != NULL || st->count >= st->block) ? STDOUT_FILENO : -1;
+    fdset[2].events = POLLOUT;
+    fdset[2].revents = 0;
+
+    // wait for stdin message or stream events
+    int rc = poll(fdset, 3, -1);
     if (rc < 0)
     {
       // Retry if EINTR
@@ -254,6 +799,18 @@ int main(int argc, char *argv[])
       log_fatal("poll");
     }
 
+    // sample first to minimize jitter
+    if (fdset[1].revents & POLLIN) stream_sample(&spi);
+    if (fdset[2].revents & (POLLOUT | POLLERR))
+    {
+      if (st->out == NULL) stream_encode_block(st, st->block);
+      stream_write_out(st);
+    }
+    if (!(fdset[0].revents & (POLLIN | POLLHUP))) continue;
+
+    // finish pending block so responses are not interleaved
+    if (st->out != NULL) stream_flush_out(st);
+
     // read message
     if (pack_read(stdin, buf) < 0)
     {
@@ -271,6 +828,7 @@ int main(int argc, char *argv[])
   }
 
   // graceful exit
+  if (spi.stream.active) stream_free(&spi.stream);
   log_debug("fanspi: bye-bye");
   return 0;
 }
\ No newline at end of file
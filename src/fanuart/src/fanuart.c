@@ -15,6 +15,8 @@
 #include <errno.h>
 #include <poll.h>
 #include <unistd.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
 #include "../../common/src/log.h"
 #include "../../common/src/pack.h"
 #include "uart_enum.h"
@@ -66,33 +68,228 @@ static void send_err(char *msg)
   pack_map_free(res);
 }
 
+/*
+ * Add uart_signals fields to given pack_map.
+ */
+static void set_signals(struct pack_map *res, struct uart_signals *sig)
+{
+  pack_set_bool(res, "dsr", sig->dsr);
+  pack_set_bool(res, "dtr", sig->dtr);
+  pack_set_bool(res, "rts", sig->rts);
+  pack_set_bool(res, "st",  sig->st);
+  pack_set_bool(res, "sr",  sig->sr);
+  pack_set_bool(res, "cts", sig->cts);
+  pack_set_bool(res, "cd",  sig->cd);
+  pack_set_bool(res, "rng", sig->rng);
+}
+
 //////////////////////////////////////////////////////////////////////////
 // Enum
 //////////////////////////////////////////////////////////////////////////
 
+/*
+ * Encode serial port meta-data into a new pack_map.
+ */
+static struct pack_map* port_to_pack(struct serial_info *port)
+{
+  struct pack_map *m = pack_map_new();
+  if (port->description)   pack_set_str(m, "desc",    port->description);
+  if (port->manufacturer)  pack_set_str(m, "man",     port->manufacturer);
+  if (port->serial_number) pack_set_str(m, "ser_num", port->serial_number);
+  if (port->vid)           pack_set_int(m, "vid",     port->vid);
+  if (port->pid)           pack_set_int(m, "pid",     port->pid);
+  return m;
+}
+
+/*
+ * Write the given port list to stdout.
+ */
+static void write_ports(struct serial_info *port_list)
+{
+  struct pack_map *map = pack_map_new();
+
+  for (struct serial_info *port=port_list; port != NULL; port=port->next)
+    pack_set_map(map, port->name, port_to_pack(port));
+
+  pack_write(stdout, map);
+  pack_map_free(map);
+}
+
 /*
  * Enumerate the available serial ports.
  */
 static void enum_ports()
 {
   struct serial_info *port_list = find_serialports();
-  struct pack_map *map = pack_map_new();
+  write_ports(port_list);
+  serial_info_free_list(port_list);
+}
 
-  for (struct serial_info *port=port_list; port != NULL; port=port->next)
+//////////////////////////////////////////////////////////////////////////
+// Monitor
+//////////////////////////////////////////////////////////////////////////
+
+/*
+ * Open a netlink socket to receive kernel uevents.
+ * Returns the socket fd or -1 if failed.
+ */
+static int uevent_open()
+{
+  int fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+  if (fd < 0) return -1;
+
+  struct sockaddr_nl addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.nl_family = AF_NETLINK;
+  addr.nl_groups = 1;  // kernel uevents
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
   {
-    struct pack_map *m = pack_map_new();
-    if (port->description)   pack_set_str(m, "desc",    port->description);
-    if (port->manufacturer)  pack_set_str(m, "man",     port->manufacturer);
-    if (port->serial_number) pack_set_str(m, "ser_num", port->serial_number);
-    if (port->vid)           pack_set_int(m, "vid",     port->vid);
-    if (port->pid)           pack_set_int(m, "pid",     port->pid);
-    pack_set_map(map, port->name, m);
+    close(fd);
+    return -1;
   }
 
-  pack_write(stdout, map);
+  return fd;
+}
 
+/*
+ * Find value for 'key' in a uevent message, where the message
+ * is a list of NUL-terminated KEY=VAL strings.  Returns NULL
+ * if key not found.
+ */
+static char* uevent_get(char *msg, ssize_t len, const char *key)
+{
+  size_t klen = strlen(key);
+  ssize_t off = 0;
+  while (off < len)
+  {
+    char *s = msg + off;
+    if (strncmp(s, key, klen) == 0 && s[klen] == '=') return s + klen + 1;
+    off += strlen(s) + 1;
+  }
+  return NULL;
+}
+
+/*
+ * Remove port with 'name' from cached list. Returns true if
+ * port was found and removed, false otherwise.
+ */
+static bool cache_remove(struct serial_info **list, const char *name)
+{
+  struct serial_info **p = list;
+  while (*p != NULL)
+  {
+    if (strcmp((*p)->name, name) == 0)
+    {
+      struct serial_info *q = *p;
+      *p = q->next;
+      serial_info_free(q);
+      free(q);
+      return true;
+    }
+    p = &(*p)->next;
+  }
+  return false;
+}
+
+/*
+ * Push a hotplug event for port 'name' to stdout. If 'port'
+ * is NULL the port was removed.
+ */
+static void send_port_event(const char *name, struct serial_info *port)
+{
+  struct pack_map *ev = pack_map_new();
+  pack_set_str(ev, "event", port ? "add" : "remove");
+  pack_set_str(ev, "name",  (char *)name);
+  if (port) pack_set_map(ev, "port", port_to_pack(port));
+  if (pack_write(stdout, ev) < 0) log_debug("fanuart: send_port_event failed");
+  pack_map_free(ev);
+}
+
+/*
+ * Process a single uevent message and update cached port list.
+ */
+static void on_uevent(struct serial_info **list, char *msg, ssize_t len)
+{
+  char *action    = uevent_get(msg, len, "ACTION");
+  char *subsystem = uevent_get(msg, len, "SUBSYSTEM");
+  char *devname   = uevent_get(msg, len, "DEVNAME");
+
+  if (action == NULL || subsystem == NULL || devname == NULL) return;
+  if (strcmp(subsystem, "tty") != 0) return;
+
+  // DEVNAME may or may not include the /dev/ prefix
+  if (strncmp(devname, "/dev/", 5) == 0) devname += 5;
+
+  if (strcmp(action, "add") == 0)
+  {
+    struct serial_info *port = find_serialport(devname);
+    if (port == NULL) return;
+    cache_remove(list, devname);
+    port->next = *list;
+    *list = port;
+    log_debug("fanuart: port added %s", devname);
+    send_port_event(devname, port);
+  }
+  else if (strcmp(action, "remove") == 0)
+  {
+    if (!cache_remove(list, devname)) return;
+    log_debug("fanuart: port removed %s", devname);
+    send_port_event(devname, NULL);
+  }
+}
+
+/*
+ * Enumerate available serial ports, then continue to listen
+ * for hotplug events and push changes to stdout until stdin
+ * is closed or any input is received.
+ */
+static void monitor_ports()
+{
+  int nl = uevent_open();
+  if (nl < 0) log_fatal("fanuart: uevent socket failed: %s", strerror(errno));
+
+  // initial scan
+  struct serial_info *port_list = find_serialports();
+  write_ports(port_list);
+
+  char msg[8192];
+  for (;;)
+  {
+    struct pollfd fdset[2];
+
+    fdset[0].fd = STDIN_FILENO;
+    fdset[0].events = POLLIN;
+    fdset[0].revents = 0;
+
+    fdset[1].fd = nl;
+    fdset[1].events = POLLIN;
+    fdset[1].revents = 0;
+
+    int rc = poll(fdset, 2, -1);
+    if (rc < 0)
+    {
+      // Retry if EINTR
+      if (errno == EINTR) continue;
+      log_fatal("poll");
+    }
+
+    if (fdset[1].revents & POLLIN)
+    {
+      ssize_t len = recv(nl, msg, sizeof(msg)-1, MSG_DONTWAIT);
+      if (len > 0)
+      {
+        msg[len] = '\0';
+        on_uevent(&port_list, msg, len);
+      }
+    }
+
+    // Any notification from Fantom is to exit
+    if (fdset[0].revents & (POLLIN | POLLHUP)) break;
+  }
+
+  close(nl);
   serial_info_free_list(port_list);
-  pack_map_free(map);
+  log_debug("fanuart: bye-bye");
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -121,6 +318,14 @@ static void parse_config(struct pack_map *m, struct uart_config *config)
     else if (strcmp(f, "hw")   == 0) config->flow_control = UART_FLOWCONTROL_HARDWARE;
     else if (strcmp(f, "sw")   == 0) config->flow_control = UART_FLOWCONTROL_SOFTWARE;
   }
+  if (pack_has(m, "rs485"))             config->rs485 = pack_get_bool(m, "rs485");
+  if (pack_has(m, "rs485_rts_on_send")) config->rs485_rts_on_send  = pack_get_bool(m, "rs485_rts_on_send");
+  if (pack_has(m, "rs485_rx_during_tx")) config->rs485_rx_during_tx = pack_get_bool(m, "rs485_rx_during_tx");
+  if (pack_has(m, "rs485_before"))      config->rs485_delay_before = pack_get_int(m, "rs485_before");
+  if (pack_has(m, "rs485_after"))       config->rs485_delay_after  = pack_get_int(m, "rs485_after");
+  if (pack_has(m, "low_latency"))       config->low_latency = pack_get_bool(m, "low_latency");
+  if (pack_has(m, "read_min"))          config->read_min  = pack_get_int(m, "read_min");
+  if (pack_has(m, "read_time"))         config->read_time = pack_get_int(m, "read_time");
 }
 
 /*
@@ -142,6 +347,9 @@ static void on_open(struct pack_map *req)
   parse_config(req, &config);
   log_debug("fanuart: parse_config speed=%d data=%d stop=%d parity=%d flow=%d",
     config.speed, config.data_bits, config.stop_bits, config.parity, config.flow_control);
+  log_debug("fanuart: parse_config rs485=%d before=%d after=%d low_latency=%d vmin=%d vtime=%d",
+    config.rs485, config.rs485_delay_before, config.rs485_delay_after,
+    config.low_latency, config.read_min, config.read_time);
 
   // if uart already open, close and open it again
   if (uart_is_open(uart)) uart_close(uart);
@@ -268,6 +476,11 @@ static void on_write(struct pack_map *req)
   if (len  <= 0)    { send_err("missing or invalid 'len' field"); return;  }
   if (data == NULL) { send_err("missing or invalid 'data' field"); return; }
 
+  // optionally assert RTS for the duration of the write (RS-485
+  // direction control) so the caller does not need a round trip
+  bool rts = pack_get_bool(req, "rts");
+  if (rts && uart_set_rts(uart, true) < 0) { send_err((char *)uart_last_error()); return; }
+
   // loop until all bytes written
   while (written < len)
   {
@@ -278,14 +491,118 @@ static void on_write(struct pack_map *req)
     } while (w < 0 && errno == EINTR);
 
     // write failed
-    if (w < 0) { send_err("write failed"); return; }
+    if (w < 0)
+    {
+      if (rts) uart_set_rts(uart, false);
+      send_err("write failed");
+      return;
+    }
 
     written += w;
   }
 
+  // wait for last byte to leave the shift register before releasing RTS
+  if (rts)
+  {
+    int r = uart_drain(uart);
+    uart_set_rts(uart, false);
+    if (r < 0) { send_err((char *)uart_last_error()); return; }
+  }
+
   send_ok();
 }
 
+/*
+ * Set or clear the RTS, DTR, or break signal.
+ */
+static void on_set_signal(struct pack_map *req, int (*set)(struct uart *, bool))
+{
+  // debug
+  char *d = pack_debug(req);
+  log_debug("fanuart: on_set_signal %s", d);
+  free(d);
+
+  // verify open
+  if (!uart_is_open(uart)) { send_err("port not open"); return; }
+  if (!pack_has(req, "val")) { send_err("missing 'val' field"); return; }
+
+  if (set(uart, pack_get_bool(req, "val")) < 0)
+    send_err((char *)uart_last_error());
+  else
+    send_ok();
+}
+
+/*
+ * Read current state of all signals.
+ */
+static void on_signals(struct pack_map *req)
+{
+  // debug
+  char *d = pack_debug(req);
+  log_debug("fanuart: on_signals %s", d);
+  free(d);
+
+  // verify open
+  if (!uart_is_open(uart)) { send_err("port not open"); return; }
+
+  struct uart_signals sig;
+  if (uart_get_signals(uart, &sig) < 0) { send_err((char *)uart_last_error()); return; }
+
+  struct pack_map *res = pack_map_new();
+  pack_set_str(res, "status", "ok");
+  set_signals(res, &sig);
+  if (pack_write(stdout, res) < 0) log_debug("fanuart: on_signals failed");
+  pack_map_free(res);
+}
+
+/*
+ * Block until all written data has been transmitted.
+ */
+static void on_drain(struct pack_map *req)
+{
+  // debug
+  char *d = pack_debug(req);
+  log_debug("fanuart: on_drain %s", d);
+  free(d);
+
+  // verify open
+  if (!uart_is_open(uart)) { send_err("port not open"); return; }
+
+  if (uart_drain(uart) < 0)
+    send_err((char *)uart_last_error());
+  else
+    send_ok();
+}
+
+/*
+ * Flush the receive and/or transmit queues.
+ */
+static void on_flush(struct pack_map *req)
+{
+  // debug
+  char *d = pack_debug(req);
+  log_debug("fanuart: on_flush %s", d);
+  free(d);
+
+  // verify open
+  if (!uart_is_open(uart)) { send_err("port not open"); return; }
+
+  enum uart_direction dir = UART_DIRECTION_BOTH;
+  char *s = pack_get_str(req, "dir");
+  if (s != NULL)
+  {
+         if (strcmp(s, "rx")   == 0) dir = UART_DIRECTION_RECEIVE;
+    else if (strcmp(s, "tx")   == 0) dir = UART_DIRECTION_TRANSMIT;
+    else if (strcmp(s, "both") == 0) dir = UART_DIRECTION_BOTH;
+    else { send_err("invalid 'dir' field"); return; }
+  }
+
+  if (uart_flush(uart, dir) < 0)
+    send_err((char *)uart_last_error());
+  else
+    send_ok();
+}
+
 /*
  * Callback to process an incoming Fantom request.
  * Returns -1 if process should exit, or 0 to continue.
@@ -298,6 +615,12 @@ static int on_proc_req(struct pack_map *req)
   if (strcmp(op, "write") == 0) { on_write(req); return 0; }
   if (strcmp(op, "open")  == 0) { on_open(req);  return 0; }
   if (strcmp(op, "close") == 0) { on_close(req); return 0; }
+  if (strcmp(op, "set_rts")   == 0) { on_set_signal(req, uart_set_rts);   return 0; }
+  if (strcmp(op, "set_dtr")   == 0) { on_set_signal(req, uart_set_dtr);   return 0; }
+  if (strcmp(op, "set_break") == 0) { on_set_signal(req, uart_set_break); return 0; }
+  if (strcmp(op, "signals")   == 0) { on_signals(req); return 0; }
+  if (strcmp(op, "drain")     == 0) { on_drain(req);   return 0; }
+  if (strcmp(op, "flush")     == 0) { on_flush(req);   return 0; }
   if (strcmp(op, "exit")  == 0) { return -1; }
 
   log_debug("fanuart: unknown op '%s'", op);
@@ -305,13 +628,75 @@ static int on_proc_req(struct pack_map *req)
 }
 
 //////////////////////////////////////////////////////////////////////////
-// Main
+// Watch
 //////////////////////////////////////////////////////////////////////////
 
 static void on_write_completed(int rc, const uint8_t *data) {}
 static void on_read_completed(int rc, const uint8_t *data, size_t len) {}
 static void on_notify_read(int rc, const uint8_t *data, size_t len) {}
 
+/*
+ * Push current signal state to stdout. Returns -1 if
+ * signals could not be read or stdout is closed.
+ */
+static int send_signals(struct uart *port)
+{
+  struct uart_signals sig;
+  if (uart_get_signals(port, &sig) < 0) return -1;
+
+  struct pack_map *res = pack_map_new();
+  pack_set_str(res, "status", "ok");
+  set_signals(res, &sig);
+  int r = pack_write(stdout, res);
+  pack_map_free(res);
+  return r;
+}
+
+/*
+ * Watch the modem input lines in comma-separated 'lines' for
+ * port 'name' using TIOCMIWAIT, and push the state of all
+ * signals to stdout on each change. The current state is
+ * pushed once on start. Runs until killed or stdout closed.
+ */
+static void watch_signals(const char *name, char *lines)
+{
+  struct uart_signals mask;
+  memset(&mask, 0, sizeof(mask));
+  for (char *t = strtok(lines, ","); t != NULL; t = strtok(NULL, ","))
+  {
+         if (strcmp(t, "dsr") == 0) mask.dsr = true;
+    else if (strcmp(t, "cts") == 0) mask.cts = true;
+    else if (strcmp(t, "cd")  == 0) mask.cd  = true;
+    else if (strcmp(t, "rng") == 0) mask.rng = true;
+    else log_fatal("fanuart: invalid signal '%s'", t);
+  }
+
+  struct uart *port;
+  if (uart_init(&port, on_write_completed, on_read_completed, on_notify_read) < 0)
+    log_fatal("uart_init failed");
+  if (uart_open_signals(port, name) < 0)
+    log_fatal("fanuart: open failed %s", uart_last_error());
+
+  // initial state so caller does not race against first change
+  if (send_signals(port) < 0) return;
+
+  for (;;)
+  {
+    if (uart_wait_signals(port, &mask) < 0)
+    {
+      if (errno == EINTR) continue;
+      log_fatal("fanuart: TIOCMIWAIT failed %s", uart_last_error());
+    }
+    if (send_signals(port) < 0) break;
+  }
+
+  uart_close(port);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Main
+//////////////////////////////////////////////////////////////////////////
+
 /*
  * Main process loop.
  */
@@ -374,9 +759,17 @@ int main(int argc, char *argv[])
   {
     enum_ports();
   }
+  else if (argc == 2 && strcmp(argv[1], "monitor") == 0)
+  {
+    monitor_ports();
+  }
+  else if (argc == 4 && strcmp(argv[1], "watch") == 0)
+  {
+    watch_signals(argv[2], argv[3]);
+  }
   else
   {
-    log_err("usage: %s [enum]", argv[0]);
+    log_err("usage: %s [enum|monitor|watch <name> <cts,cd,rng,dsr>]", argv[0]);
     exit(1);
   }
   return 0;
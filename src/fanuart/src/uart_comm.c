@@ -64,6 +64,14 @@ void uart_default_config(struct uart_config *config)
     config->stop_bits = 1;
     config->parity = UART_PARITY_NONE;
     config->flow_control = UART_FLOWCONTROL_NONE;
+    config->rs485 = false;
+    config->rs485_rts_on_send = true;
+    config->rs485_rx_during_tx = false;
+    config->rs485_delay_before = 0;
+    config->rs485_delay_after = 0;
+    config->low_latency = false;
+    config->read_min = 1;
+    config->read_time = 0;
 }
 
 static const char *last_error = "ok";
@@ -305,10 +313,10 @@ static int uart_config_line(int fd, const struct uart_config *config)
     options.c_lflag = 0;
     options.c_iflag &= ~(ICRNL|INLCR);  // No CR<->LF conversions
 
-    // It seems like these should be ignored since we
-    // open the port as O_NONBLOCK
-    options.c_cc[VMIN] = 1;
-    options.c_cc[VTIME] = 0;
+    // These are ignored while the port is O_NONBLOCK, which
+    // is the default unless read_time is set; see uart_config_blocking
+    options.c_cc[VMIN] = config->read_min;
+    options.c_cc[VTIME] = config->read_time;
 
     // Set everything
     return tcsetattr(fd, TCSANOW, &options);
@@ -348,6 +356,115 @@ static int uart_config_flowcontrol(int fd, const struct uart_config *config)
     return tcsetattr(fd, TCSANOW, &options);
 }
 
+/**
+ * @brief Configure kernel RS-485 mode where the driver toggles RTS
+ *
+ * @param fd
+ * @param config
+ * @return <0 on error
+ */
+static int uart_config_rs485(int fd, const struct uart_config *config)
+{
+    struct serial_rs485 rs485;
+    memset(&rs485, 0, sizeof(rs485));
+
+    if (!config->rs485) {
+        // Only clear if the driver supports RS-485 and it is enabled,
+        // since most drivers will fail TIOCSRS485 with ENOTTY.
+        if (ioctl(fd, TIOCGRS485, &rs485) < 0 || !(rs485.flags & SER_RS485_ENABLED))
+            return 0;
+        rs485.flags &= ~SER_RS485_ENABLED;
+        return ioctl(fd, TIOCSRS485, &rs485);
+    }
+
+    rs485.flags = SER_RS485_ENABLED;
+    if (config->rs485_rts_on_send)
+        rs485.flags |= SER_RS485_RTS_ON_SEND;
+    else
+        rs485.flags |= SER_RS485_RTS_AFTER_SEND;
+    if (config->rs485_rx_during_tx)
+        rs485.flags |= SER_RS485_RX_DURING_TX;
+    rs485.delay_rts_before_send = config->rs485_delay_before;
+    rs485.delay_rts_after_send = config->rs485_delay_after;
+
+    return ioctl(fd, TIOCSRS485, &rs485);
+}
+
+/**
+ * @brief Configure the ASYNC_LOW_LATENCY flag for the port
+ *
+ * @param fd
+ * @param config
+ * @return <0 on error
+ */
+static int uart_config_low_latency(int fd, const struct uart_config *config)
+{
+    struct serial_struct serinfo;
+    if (ioctl(fd, TIOCGSERIAL, &serinfo) < 0)
+        return config->low_latency ? -1 : 0;
+
+    bool cur = (serinfo.flags & ASYNC_LOW_LATENCY) != 0;
+    if (cur == config->low_latency)
+        return 0;
+
+    if (config->low_latency)
+        serinfo.flags |= ASYNC_LOW_LATENCY;
+    else
+        serinfo.flags &= ~ASYNC_LOW_LATENCY;
+
+    return ioctl(fd, TIOCSSERIAL, &serinfo);
+}
+
+/**
+ * @brief Put the port in blocking mode if read batching is
+ *        enabled so that VMIN/VTIME take effect
+ *
+ * @param fd
+ * @param config
+ * @return <0 on error
+ */
+static int uart_config_blocking(int fd, const struct uart_config *config)
+{
+    int flags = fcntl(fd, F_GETFL);
+    if (flags < 0)
+        return -1;
+
+    if (config->read_time > 0)
+        flags &= ~O_NONBLOCK;
+    else
+        flags |= O_NONBLOCK;
+
+    return fcntl(fd, F_SETFL, flags);
+}
+
+/**
+ * @brief Apply the optional RS-485, low latency and read
+ *        batching settings
+ *
+ * @param fd
+ * @param config
+ * @return <0 on error
+ */
+static int uart_config_extra(int fd, const struct uart_config *config)
+{
+    if (uart_config_rs485(fd, config) < 0) {
+        log_debug("uart_config_rs485 failed");
+        return -1;
+    }
+
+    if (uart_config_low_latency(fd, config) < 0) {
+        log_debug("uart_config_low_latency failed");
+        return -1;
+    }
+
+    if (uart_config_blocking(fd, config) < 0) {
+        log_debug("uart_config_blocking failed");
+        return -1;
+    }
+
+    return 0;
+}
+
 static char *name_to_device_file(const char *name)
 {
     // If passed "ttyS0", return "/dev/ttyS0".
@@ -420,6 +537,11 @@ int uart_open(struct uart *port, const char *name, const struct uart_config *con
         return -1;
     }
 
+    if (uart_config_extra(port->fd, config) < 0) {
+        record_errno();
+        return -1;
+    }
+
     port->active_mode_enabled = config->active;
 
     // Clear garbage data from RX/TX queues
@@ -428,6 +550,26 @@ int uart_open(struct uart *port, const char *name, const struct uart_config *con
     return 0;
 }
 
+int uart_open_signals(struct uart *port, const char *name)
+{
+    char *uart_path = name_to_device_file(name);
+    if (!uart_path) {
+        log_debug("Can't convert '%s' to uart path", name);
+        return -1;
+    }
+
+    port->fd = open(uart_path, O_RDONLY | O_NOCTTY | O_CLOEXEC | O_NONBLOCK);
+    free(uart_path);
+
+    if (port->fd < 0) {
+        log_debug("open failed on '%s'", name);
+        record_errno();
+        return -1;
+    }
+
+    return 0;
+}
+
 int uart_is_open(struct uart *port)
 {
     return port->fd != -1;
@@ -459,6 +601,11 @@ int uart_configure(struct uart *port, const struct uart_config *config)
         return -1;
     }
 
+    if (uart_config_extra(port->fd, config) < 0) {
+        record_errno();
+        return -1;
+    }
+
     return 0;
 }
 
@@ -784,6 +931,22 @@ int uart_get_signals(struct uart *port, struct uart_signals *sig)
     return 0;
 }
 
+int uart_wait_signals(struct uart *port, const struct uart_signals *mask)
+{
+    int status = 0;
+    if (mask->dsr) status |= TIOCM_DSR;
+    if (mask->cts) status |= TIOCM_CTS;
+    if (mask->cd)  status |= TIOCM_CD;
+    if (mask->rng) status |= TIOCM_RNG;
+
+    if (ioctl(port->fd, TIOCMIWAIT, status) < 0) {
+        record_errno();
+        return -1;
+    }
+
+    return 0;
+}
+
 /**
  * @brief Update the poll timeout based on the specified deadline
  */
@@ -53,6 +53,22 @@ struct uart_config
     int stop_bits;  // 1 or 2
     enum uart_parity parity;
     enum uart_flow_control flow_control;
+
+    // Kernel RS-485 mode (TIOCSRS485)
+    bool rs485;
+    bool rs485_rts_on_send;     // RTS level while sending
+    bool rs485_rx_during_tx;    // Receive own transmission
+    int rs485_delay_before;     // RTS assert to start of tx in ms
+    int rs485_delay_after;      // End of tx to RTS release in ms
+
+    // Set ASYNC_LOW_LATENCY to disable driver rx batching
+    bool low_latency;
+
+    // Read batching (VMIN/VTIME). When read_time > 0 the port is
+    // put in blocking mode so reads return up to read_min bytes
+    // or once read_time (1/10 sec) elapses between bytes.
+    int read_min;
+    int read_time;
 };
 
 struct uart_signals
@@ -132,6 +148,19 @@ int uart_is_open(struct uart *port);
  */
 int uart_open(struct uart *port, const char *name, const struct uart_config *config);
 
+/**
+ * @brief Open the specified UART port to monitor signals only
+ *
+ * The port is not locked or configured, so this may be used
+ * alongside another process that has the port open with
+ * uart_open().
+ *
+ * @param port the uart struct
+ * @param name  the name of the port to open
+ * @return 0 on success, <0 on error
+ */
+int uart_open_signals(struct uart *port, const char *name);
+
 /**
  * @brief Close and free up the resources for a UART
  * @param port the uart struct
@@ -242,6 +271,18 @@ int uart_set_break(struct uart *port, bool val);
  */
 int uart_get_signals(struct uart *port, struct uart_signals *sig);
 
+/**
+ * @brief Block until one of the signals in mask changes state
+ *
+ * Only the dsr, cts, cd and rng fields of mask are used, since
+ * these are the only inputs the kernel can wait on.
+ *
+ * @param port the uart struct
+ * @param mask the signals to wait on
+ * @return 0 on success
+ */
+int uart_wait_signals(struct uart *port, const struct uart_signals *mask);
+
 #if defined(__linux__) || defined(__APPLE__)
 struct pollfd;
 
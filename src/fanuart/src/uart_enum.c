@@ -80,13 +80,12 @@ static int has_string_prefix(const char *prefix, const char *s)
     return strncmp(prefix, s, len) == 0;
 }
 
-static int is_tty_filename(const struct dirent *d)
+static int is_tty_name(const char *name)
 {
     // Check the device filename against a list of known serial
     // port types. This list was found at
     // http://code.qt.io/cgit/qt/qtserialport.git/tree/src/serialport/qserialportinfo_unix.cpp
 
-    const char *name = d->d_name;
     if (has_string_prefix("ttyS", name) ||         // Standard UART 8250 and etc.
             has_string_prefix("ttyO", name) ||     // OMAP UART 8250 and etc.
             has_string_prefix("ttyUSB", name) ||   // USB/serial converters PL2303 and etc.
@@ -104,6 +103,11 @@ static int is_tty_filename(const struct dirent *d)
         return 0;
 }
 
+static int is_tty_filename(const struct dirent *d)
+{
+    return is_tty_name(d->d_name);
+}
+
 static int try_read_all(const char *directory, const char *filename, char **result)
 {
     static const size_t max_filesize = 4096;
@@ -250,6 +254,45 @@ static int is_real_serialport(const char *devname, const char *tty_path)
     return rc;
 }
 
+static struct serial_info *get_serialport(const char *devname)
+{
+    char filepath[256];
+    sprintf(filepath, "/sys/class/tty/%s", devname);
+
+    if (!is_real_serialport(devname, filepath))
+        return NULL;
+
+    char symlink[256];
+    ssize_t rc = readlink(filepath, symlink, sizeof(symlink) - 1);
+    if (rc <= 0)
+        return NULL;
+
+    symlink[rc] = 0;
+    char info_filepath[PATH_MAX];
+    sprintf(info_filepath, "/sys/class/tty/%s", symlink);
+    struct serial_info *info = serial_info_alloc();
+    info->name = strdup(devname);
+    while (info_filepath[0] != '\0') {
+        if (get_serialport_info(info_filepath, info))
+            break;
+
+        // Go up a directory
+        char *pos = strrchr(info_filepath, '/');
+        if (pos != NULL)
+            *pos = '\0';
+    }
+    return info;
+}
+
+struct serial_info *find_serialport(const char *devname)
+{
+    // Apply the same filename filter as scandir in find_serialports
+    if (!is_tty_name(devname))
+        return NULL;
+
+    return get_serialport(devname);
+}
+
 struct serial_info *find_serialports()
 {
     struct dirent **namelist;
@@ -260,29 +303,8 @@ struct serial_info *find_serialports()
         return info;
 
     for (int i = 0; i < n; i++) {
-        char filepath[256];
-        sprintf(filepath, "/sys/class/tty/%s", namelist[i]->d_name);
-
-        if (!is_real_serialport(namelist[i]->d_name, filepath))
-            continue;
-
-        char symlink[256];
-        ssize_t rc = readlink(filepath, symlink, sizeof(symlink));
-        if (rc > 0) {
-            symlink[rc] = 0;
-            char info_filepath[PATH_MAX];
-            sprintf(info_filepath, "/sys/class/tty/%s", symlink);
-            struct serial_info *new_info = serial_info_alloc();
-            new_info->name = strdup(namelist[i]->d_name);
-            while (info_filepath[0] != '\0') {
-                if (get_serialport_info(info_filepath, new_info))
-                    break;
-
-                // Go up a directory
-                char *pos = strrchr(info_filepath, '/');
-                if (pos != NULL)
-                    *pos = '\0';
-            }
+        struct serial_info *new_info = get_serialport(namelist[i]->d_name);
+        if (new_info) {
             new_info->next = info;
             info = new_info;
         }
@@ -35,5 +35,6 @@ void serial_info_free_list(struct serial_info *info);
 
 // Prototypes for device-specific code
 struct serial_info *find_serialports();
+struct serial_info *find_serialport(const char *devname);
 
 #endif // UART_ENUM_H
@@ -7,6 +7,10 @@
 */
 
 #include "jni.h"
+#include <errno.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/resource.h>
 #include <sys/types.h>
 #include <netinet/in.h>
 #include <arpa/nameser.h>
@@ -18,4 +22,38 @@
 JNIEXPORT jlong JNICALL Java_fan_studs_LibFanPeer_doReloadResolvConf(JNIEnv *env, jclass cls)
 {
   return res_init();
-}
\ No newline at end of file
+}
+
+/*
+ * Set scheduling policy, nice or realtime priority, and cpu affinity
+ * for process 'pid'. A 'policy' of -1 leaves policy unchanged and a
+ * 'cpus' mask of 0 leaves affinity unchanged. Returns 0 or errno.
+ */
+JNIEXPORT jlong JNICALL Java_fan_studs_LibFanPeer_doSetSched(JNIEnv *env, jclass cls,
+  jlong pid, jlong policy, jlong value, jboolean hasValue, jlong cpus)
+{
+  int rt = policy == SCHED_FIFO || policy == SCHED_RR;
+
+  if (cpus != 0)
+  {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    int i;
+    for (i=0; i<64; i++)
+      if (((unsigned long long)cpus >> i) & 1) CPU_SET(i, &set);
+    if (sched_setaffinity(pid, sizeof(set), &set) < 0) return errno;
+  }
+
+  if (policy >= 0)
+  {
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    if (rt) param.sched_priority = value;
+    if (sched_setscheduler(pid, policy, &param) < 0) return errno;
+  }
+
+  // nice only applies to normal policies
+  if (hasValue && !rt && setpriority(PRIO_PROCESS, pid, value) < 0) return errno;
+
+  return 0;
+}
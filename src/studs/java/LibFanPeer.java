@@ -16,4 +16,6 @@ public class LibFanPeer
   }
 
   public static native long doReloadResolvConf();
+
+  public static native long doSetSched(long pid, long policy, long value, boolean hasValue, long cpus);
 }
\ No newline at end of file